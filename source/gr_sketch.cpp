@@ -6,11 +6,16 @@
 #include "StopWatch.h"
 #include "BleCommunicator.h"
 #include "BleMidiCommunicator.h"
+#include "SerialMidiCommunicator.h"
+#include "MelodyStore.h"
+#include "Rn4020Simulator.h"
 #include "MelodyCommandReceiver.h"
 #include "PitchDiagnostic.h"
+#include "SilenceGate.h"
 #include "CommonTool.h"
 
 #define USE_MIDI_OVER_BLE
+//#define USE_MIDI_OVER_SERIAL	// wired midi on SERIAL_MIDI_PORT instead of RN4020
 
 //#define _DEBUG
 #define LOG_PRINTF	Serial.print
@@ -22,35 +27,96 @@
 //#define LOOPBREAK()         loopBreak()
 #define LOOPBREAK()
 //#define DEBUG_OUTPUT_NUM    256
+//#define TRACE_FRAMES		// "timestamp note volume clarity" per frame for host/EdgeBench. leave _DEBUG off
 
 #define ON	true
 #define OFF	false
 
+// silence gate thresholds in rms of adc counts. below EdgeDetector's volume cutoff
+#define SILENCE_OPEN_RMS	32
+#define SILENCE_CLOSE_RMS	16
+#define SILENCE_IDLE_MS		20	// HALT time between probes while silent
+#define SILENCE_PROBE_NUM	64	// samples taken by a probe
+
+#define STATS_REPORT_INTERVAL	10000	// ms between event queue and Rn4020Simulator stats
+
+// tuning feedback
+#define TUNING_INTERVAL		10	// frames averaged for one feedback
+#define TUNING_TOLERANCE	(10 << CENTS_SHFT)	// +-10 cents is good
+
+// melody command index
+#define CMD_IDX_GAIN		0
+#define CMD_IDX_TUNING_MODE	1
+#define CMD_IDX_TUNING		6
+
+// response melody
+#define RESPONSE_LEAD_MS	1000			// silence before response to melody command
+#define PLAYBACK_INTERRUPT	kPlaybackDuck	// when user sings over response
+
+// vibrato and glides of the held note. BleCommunicator streams them unless kBendOff
+#define PITCH_BEND_MODE		kBendPitchPressure
+#define PITCH_BEND_SEMITONES	2	// farther pitch waits for the edge
+#define VELOCITY_CURVE		kVelocitySoft
+
+// notify attacks from silence on their first frame. host/EdgeBench shows more false note-ons with it
+#define EDGE_PREDICTION		OFF
+
+// melody command matching. sung key doesn't matter.
+// tolerance 1 forgives one wrong interval of 5 note commands(see host/MelodyCorpus.txt)
+// but runs a MelodyDetector per command instead of the automaton
+#define MELODY_MATCH_MODE		kMelodyMatchInterval
+#define MELODY_MATCH_TOLERANCE	0
+
+typedef struct TuningPreset_tag {
+	uint16_t refFreq;
+	uint8_t temperament;
+	uint8_t tonic;
+} TuningPreset_t;
+
+// cycled by tuning melody command
+static const TuningPreset_t kTuningPresets[] = {
+	{ 440,	kTemperamentEqual,			0 },
+	{ 442,	kTemperamentEqual,			0 },
+	{ 415,	kTemperamentEqual,			0 },
+	{ 440,	kTemperamentJust,			0 },	// C
+	{ 440,	kTemperamentPythagorean,	0 },	// C
+};
+
 // Pin 22,23,24 are assigned to RGB LEDs.
 int led_red   = 22; // LOW active
 int led_green = 23; // LOW active
 int led_blue  = 24; // LOW active
 int led_pin   = 5;
 
-#if defined (USE_MIDI_OVER_BLE)
+#if defined (USE_MIDI_OVER_SERIAL)
+SerialMidiCommunicator com(SERIAL_MIDI_PORT);
+#elif defined (USE_MIDI_OVER_BLE)
 BleMidiCommunicator com;
 #else
 BleCommunicator com;
 #endif
 static Communicator& s_com = com;
 static PitchDetectorFp s_pitch;
-static EdgeDetector s_edge;
+static EdgeDetector<3, 2> s_edge;	// 2 of 3 frames agreement
 static MelodyCommandReceiver s_mcr;
-static PitchDiagnostic s_pd(20);
+static PitchDiagnostic s_pd(TUNING_INTERVAL, TUNING_TOLERANCE);
+static uint8_t s_tuningPreset = 0;
+static SilenceGate s_gate(SILENCE_OPEN_RMS, SILENCE_CLOSE_RMS);
 
 static inline void detectPitch(PitchInfo_t* pitchInfo);
+static inline void waitForVoice(PitchInfo_t* pitchInfo);
+static inline void updateGate();
 static inline bool processMelodyCommand(uint16_t note);
 static inline void processResult(PitchInfo_t* pitchInfo);
-static inline void processPitchDiagnostic(int8_t pitch, bool edge);
+static inline void processPitchDiagnostic(int16_t cents, uint8_t note);
+static inline void streamPitch(const PitchInfo_t* pitchInfo, uint16_t note);
+static inline void processTuningRequest();
 static inline void readDataFp(Fp_t* data, uint8_t stride, const int dataNum, Fp_t* x_min, Fp_t* x_max);
 static inline void SetLeds(bool red, bool green, bool blue, bool led);
 static inline void GoToErrorState();
 static inline void loopBreak();
+static inline void reportStats();
+static inline void traceFrame(const PitchInfo_t* pitchInfo);
 
 void setup()
 {
@@ -67,9 +133,14 @@ void setup()
 	
 	SetLeds(ON,ON,ON,ON);
 	
+	// compiled melodies are used if data flash has none
+	MelodyStore.Load();
 	if(s_com.Initialize() != 0) {
 		GoToErrorState();
 	}
+	s_com.SetBendMode(PITCH_BEND_MODE);
+	s_com.SetVelocityCurve(VELOCITY_CURVE);
+	s_edge.SetPrediction(EDGE_PREDICTION);
 	digitalWrite(led_red, HIGH);
 	if(s_pitch.Initialize((void*)readDataFp) != 0) {
 		GoToErrorState();
@@ -84,9 +155,11 @@ void setup()
 			{ kMelEli0,		kMelEli1,	kMelEli0Count,	kMelEli1Count },    // kInstPno
 			{ kMelDev0,		kMelDev1,	kMelDev0Count,	kMelDev1Count },    // kInstOrc
 			{ kMelBlk0,		kMelBlk1,	kMelBlk0Count,	kMelBlk1Count },    // kInstHmk
+			{ kMelTun0,		kMelTun1,	kMelTun0Count,	kMelTun1Count },    // CMD_IDX_TUNING
 		};
+		MelodyStore.OverrideCommands(commands, _countof(commands));
 		
-		if(!s_mcr.Initialize(commands, _countof(commands))) {
+		if(!s_mcr.Initialize(commands, _countof(commands), MELODY_MATCH_MODE, MELODY_MATCH_TOLERANCE)) {
 			GoToErrorState();
 		}
 	}
@@ -104,9 +177,15 @@ void loop() {
     ILOG("main loop");
     while(1) {
         LOOPBREAK();
-		detectPitch(&pitchInfo);
+        if(s_gate.IsOpen()) {
+            detectPitch(&pitchInfo);
+        } else {
+            waitForVoice(&pitchInfo);
+        }
         processResult(&pitchInfo);
         s_com.Yield();
+        processTuningRequest();
+        reportStats();
     }
 #else
     while(true) { delay(100);}
@@ -118,9 +197,12 @@ static void detectPitch(PitchInfo_t* pitchInfo)
 	*pitchInfo = MakePitchInfo();
     
     digitalWrite(led_green, LOW);// active hight
+    pitchInfo->timestamp = (uint16_t)millis();
+    s_gate.Begin();
     if(s_pitch.DetectPitch(pitchInfo) != 0) {
     	// could be invalid range signal
     }
+    updateGate();
     digitalWrite(led_green, HIGH);// active hight
     
     if(pitchInfo->midiNote != 0) {
@@ -130,10 +212,42 @@ static void detectPitch(PitchInfo_t* pitchInfo)
     }
 }
 
+/**
+ *  silent. sleep a while in HALT then take a short probe instead of a whole frame.
+ *  pitchInfo is cleared so that edge detector can release current note.
+ */
+static void waitForVoice(PitchInfo_t* pitchInfo)
+{
+	*pitchInfo = MakePitchInfo();
+
+	// uart and timer interrupts keep running in HALT
+	setPowerManagementMode(PM_HALT_MODE);
+	delay(SILENCE_IDLE_MS);
+	setPowerManagementMode(PM_NORMAL_MODE);
+
+	int ain_pin = s_com.GetGain();
+	pitchInfo->timestamp = (uint16_t)millis();
+	s_gate.Begin();
+	for(int i = 0; i < SILENCE_PROBE_NUM; i++) {
+		s_gate.Accumulate(analogRead(ain_pin));
+	}
+	updateGate();
+}
+
+static void updateGate()
+{
+	bool wasOpen = s_gate.IsOpen();
+	if(s_gate.End() == wasOpen) {
+		return;
+	}
+	ILOG("gate %s at %lu ms, rms=%u", wasOpen ? "close" : "open", millis(), s_gate.Rms());
+}
+
 static void processResult(PitchInfo_t* pitchInfo)
 {
 	//ILOG("note=%d, vol=%d", pitchInfo->midiNote, pitchInfo->volume);
-	bool isEdge = s_edge.Input(pitchInfo->midiNote, pitchInfo->volume);
+	traceFrame(pitchInfo);
+	bool isEdge = s_edge.Input(pitchInfo->midiNote, pitchInfo->volume, pitchInfo->clarity, pitchInfo->timestamp);
 	uint16_t note = s_edge.CurrentNote();
 	bool melodyProcessed = false;
     if(isEdge) {
@@ -144,7 +258,9 @@ static void processResult(PitchInfo_t* pitchInfo)
     		ILOG("edge! %s", pitchInfo->noteStr == NULL?"NULL":pitchInfo->noteStr);
     	}
 
-        s_com.UpdateFreq(pitchInfo->freq, note);
+        // timestamped when the note began, not when it was recognized
+        s_com.PostNote(pitchInfo->freq, note, pitchInfo->volume, s_edge.EdgeTime());
+        s_com.InterruptPlayback(note != 0 ? PLAYBACK_INTERRUPT : kPlaybackResume);
         
         melodyProcessed = processMelodyCommand(note);
     } else {
@@ -152,16 +268,46 @@ static void processResult(PitchInfo_t* pitchInfo)
         if(note != 0) {
             if(note == pitchInfo->midiNote) {
             	// event note doesn't change, freq change shoud be notified
-                s_com.UpdateFreq(pitchInfo->freq, note);
+                s_com.PostNote(pitchInfo->freq, note, pitchInfo->volume, pitchInfo->timestamp);
             }
         }
 #endif
+        if(note != 0) {
+            streamPitch(pitchInfo, note);
+        }
     }
     
     if(!melodyProcessed && s_com.IsTuningMode()) {
-    	//ILOG("pitch=%d, note=%d", (int)pitchInfo->pitch, note);
-    	processPitchDiagnostic(pitchInfo->pitch, note);
+    	// deviation is meaningful only against the note being held
+    	int16_t cents = (note == pitchInfo->midiNote) ? pitchInfo->cents : CENTS_UNKNOWN;
+    	//ILOG("cents=%d, note=%d", (int)cents, note);
+    	processPitchDiagnostic(cents, note);
     }
+    
+    // all messages of this frame in as few writes as possible
+    s_com.Flush();
+}
+
+/**
+ *  pitch of this frame relative to the held note
+ */
+static void streamPitch(const PitchInfo_t* pitchInfo, uint16_t note)
+{
+	if(pitchInfo->midiNote == 0 || pitchInfo->cents == CENTS_UNKNOWN) {
+		return;
+	}
+	int16_t semitones = (int16_t)pitchInfo->midiNote - (int16_t)note;
+	if(PITCH_BEND_SEMITONES < abs(semitones)) {
+		return;
+	}
+	PitchSample_t sample;
+	sample.cents = semitones * (100 << CENTS_SHFT) + pitchInfo->cents;
+	sample.volume = pitchInfo->volume;
+	sample.timestamp = pitchInfo->timestamp;
+	sample.freq = pitchInfo->freq;
+	sample.note = (uint8_t)note;
+	sample.clarity = pitchInfo->clarity;
+	s_com.PostPitch(&sample);
 }
 
 static bool processMelodyCommand(uint16_t note)
@@ -171,20 +317,24 @@ static bool processMelodyCommand(uint16_t note)
 	if(resp.IsEmpty()) {
 		return handled;
 	}
+	// commands below turn off the note just posted
+	s_com.DispatchEvents();
 	
 	switch(resp.evt) {
 		case kMelodyCommandEvtExcited:
     		ILOG("kMelodyCommandEvtExcited");
-    		// wait sometime to finish current note
-    		delay(1000);
+    		// let current note finish before response
+    		s_com.DelayPlayback(RESPONSE_LEAD_MS);
     		// reset state
     		s_edge.Reset();
     		s_pd.Reset();
     		// play response melody id=resp.cmmandIdx
-    		if(resp.commandIdx == 0) {
+    		if(resp.commandIdx == CMD_IDX_GAIN) {
     			s_com.ConfirmaToggleGain();
-    		} else if(resp.commandIdx == 1) {
+    		} else if(resp.commandIdx == CMD_IDX_TUNING_MODE) {
     		    s_com.ConfirmToggleTuning();
+    		} else if(resp.commandIdx == CMD_IDX_TUNING) {
+    		    s_com.ConfirmTuningChange();
     		} else {
     		   s_com.ConfirmInstChange(resp.commandIdx);
     		}
@@ -192,18 +342,24 @@ static bool processMelodyCommand(uint16_t note)
     		break;
 		case kMelodyCommandEvtFired:
     		ILOG("kMelodyCommandEvtFired");
-    		// wait sometime to finish current note
-    		delay(1000);
+    		// let current note finish before response
+    		s_com.DelayPlayback(RESPONSE_LEAD_MS);
     		// reset state
     		s_edge.Reset();
     		s_pd.Reset();
     		// execute command
-    		if(resp.commandIdx == 0) {
+    		if(resp.commandIdx == CMD_IDX_GAIN) {
     			// Change Gain
     			s_com.ToggleGain();
-    		} else if(resp.commandIdx == 1) {
+    		} else if(resp.commandIdx == CMD_IDX_TUNING_MODE) {
     			s_com.ToggleTuning();
     		    s_pd.Reset();
+    		} else if(resp.commandIdx == CMD_IDX_TUNING) {
+    			// next tuning preset
+    			s_tuningPreset = (s_tuningPreset + 1) % _countof(kTuningPresets);
+    			const TuningPreset_t* preset = &kTuningPresets[s_tuningPreset];
+    			s_pitch.SetTuning(preset->refFreq, preset->temperament, preset->tonic);
+    			s_com.ChangeTuning(s_tuningPreset);
     		} else {
     			// Change Instrument
     			s_com.ChangeInst(resp.commandIdx);
@@ -217,29 +373,49 @@ static bool processMelodyCommand(uint16_t note)
 	return handled;
 }
 
-static void processPitchDiagnostic(int8_t pitch, bool edge)
+static void processPitchDiagnostic(int16_t cents, uint8_t note)
 {
-	DiagnoseResult_t result = s_pd.Diagnose(pitch, edge);
+	DiagnoseResult_t result = s_pd.Diagnose(cents, note);
 	switch(result) {
 		case kDiagnoseResultNone:
 			break;
 		case kDiagnoseResultGood:
 		    ILOG("kDiagnoseResultGood");
-            s_com.NotifyTune(kTuneGood);
+            s_com.PostTune(kTuneGood);
 			break;
 		case kDiagnoseResultHigh:
 		    ILOG("kDiagnoseResultHigh");
-		    s_com.NotifyTune(kTuneHigh);
+		    s_com.PostTune(kTuneHigh);
 			break;
 		case kDiagnoseResultLow:
 	    	ILOG("kDiagnoseResultLow");
-		    s_com.NotifyTune(kTuneLow);
+		    s_com.PostTune(kTuneLow);
 			break;
 		default:
 			break;
 	}
 }
 
+/**
+ *  apply tuning written by remote
+ */
+static void processTuningRequest()
+{
+	uint16_t refFreq = 0;
+	uint8_t temperament = 0;
+	uint8_t tonic = 0;
+	if(!s_com.FetchTuning(&refFreq, &temperament, &tonic)) {
+		return;
+	}
+
+	if(s_pitch.SetTuning(refFreq, temperament, tonic) != 0) {
+		ILOG("invalid tuning %u,%u,%u", refFreq, temperament, tonic);
+		return;
+	}
+	s_pd.Reset();
+	ILOG("tuning %u,%u,%u", refFreq, temperament, tonic);
+}
+
 static void readDataFp(Fp_t* data, uint8_t stride, const int dataNum, Fp_t* x_min, Fp_t* x_max)
 {
 	int ain_pin = s_com.GetGain();
@@ -249,6 +425,7 @@ static void readDataFp(Fp_t* data, uint8_t stride, const int dataNum, Fp_t* x_mi
     int counter = 0;
     while (counter < dataNum) {
         *data = analogRead(ain_pin);
+        s_gate.Accumulate(*data);
 
         *x_min = min(*data, *x_min);
         *x_max = max(*data, *x_max);
@@ -293,3 +470,37 @@ static void loopBreak()
 		delay(100);
 	}
 }
+
+/**
+ *  throughput and latency seen by simulated RN4020
+ */
+static void reportStats()
+{
+	static uint32_t s_lastReport = 0;
+	if(millis() - s_lastReport < STATS_REPORT_INTERVAL) {
+		return;
+	}
+	s_lastReport = millis();
+	CommQueueStats_t stats;
+	s_com.GetQueueStats(&stats);
+	ILOG("events depth=%u max=%u dropped=%u coalesced=%u", stats.depth, stats.maxDepth, stats.dropped, stats.coalesced);
+#if defined(USE_RN4020_SIMULATOR)
+	Rn4020Sim.PrintStats(LOG_Serial);
+#endif
+}
+
+/**
+ *  input of the edge detector. replayed by host/EdgeBench
+ */
+static void traceFrame(const PitchInfo_t* pitchInfo)
+{
+#if defined(TRACE_FRAMES)
+	LOG_Serial.print(pitchInfo->timestamp);
+	LOG_Serial.print(' ');
+	LOG_Serial.print((int)pitchInfo->midiNote);
+	LOG_Serial.print(' ');
+	LOG_Serial.print(pitchInfo->volume);
+	LOG_Serial.print(' ');
+	LOG_Serial.println((int)pitchInfo->clarity);
+#endif
+}
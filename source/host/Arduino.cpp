@@ -0,0 +1,61 @@
+#include "Arduino.h"
+#include <time.h>
+
+HardwareSerial Serial(stdout);
+HardwareSerial Serial1(NULL);
+
+/**
+ *	wall clock from the first call as the board counts from reset
+ */
+unsigned long millis(void)
+{
+	static struct timespec s_start;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (s_start.tv_sec == 0 && s_start.tv_nsec == 0) {
+		s_start = now;
+	}
+	return (unsigned long)((now.tv_sec - s_start.tv_sec) * 1000 + (now.tv_nsec - s_start.tv_nsec) / 1000000);
+}
+
+void delay(unsigned long ms)
+{
+	struct timespec t;
+	t.tv_sec = ms / 1000;
+	t.tv_nsec = (ms % 1000) * 1000000;
+	nanosleep(&t, NULL);
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+	size_t n = 0;
+	while (size--) {
+		n += write(*buffer++);
+	}
+	return n;
+}
+
+size_t Print::print(long n, int base)
+{
+	char buf[24];
+	snprintf(buf, sizeof(buf), (base == HEX) ? "%lX" : "%ld", n);
+	return write(buf);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+	char buf[24];
+	snprintf(buf, sizeof(buf), (base == HEX) ? "%lX" : "%lu", n);
+	return write(buf);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+	if (_stream != NULL) {
+		return _stream->write(c);
+	}
+	if (_out != NULL) {
+		fputc(c, _out);
+	}
+	return 1;
+}
@@ -0,0 +1,87 @@
+/**
+ *	host stand-in of RLduino78 Arduino.h. only what the sketch sources use.
+ *	HardwareSerial writes to a FILE, or talks to an attached Stream such as
+ *	Rn4020Simulator in place of the module
+ */
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+#define DEC	10
+#define HEX	16
+
+#define constrain(amt, low, high)	((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long millis(void);
+void delay(unsigned long ms);
+
+class Print
+{
+public:
+	virtual ~Print() {}
+	virtual size_t write(uint8_t) = 0;
+	size_t write(const char* str) { return write((const uint8_t*)str, strlen(str)); }
+	virtual size_t write(const uint8_t* buffer, size_t size);
+
+	size_t print(const char str[]) { return write(str); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(int n, int base = DEC) { return print((long)n, base); }
+	size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+	size_t print(long n, int base = DEC);
+	size_t print(unsigned long n, int base = DEC);
+
+	size_t println(void) { return write("\r\n"); }
+	size_t println(const char str[]) { return print(str) + println(); }
+	size_t println(char c) { return print(c) + println(); }
+	size_t println(int n, int base = DEC) { return print(n, base) + println(); }
+	size_t println(unsigned int n, int base = DEC) { return print(n, base) + println(); }
+	size_t println(long n, int base = DEC) { return print(n, base) + println(); }
+	size_t println(unsigned long n, int base = DEC) { return print(n, base) + println(); }
+};
+
+class Stream : public Print
+{
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+	virtual void flush() = 0;
+};
+
+class HardwareSerial : public Stream
+{
+public:
+	HardwareSerial(FILE* out) : _out(out), _stream(NULL) {}
+
+	void begin(unsigned long baud) {}
+	void end() {}
+	/**
+	 *	host only. bytes go to and come from stream instead of the FILE
+	 */
+	void Attach(Stream* stream) { _stream = stream; }
+
+	virtual int available() { return (_stream != NULL) ? _stream->available() : 0; }
+	virtual int read() { return (_stream != NULL) ? _stream->read() : -1; }
+	virtual int peek() { return (_stream != NULL) ? _stream->peek() : -1; }
+	virtual void flush() {}
+	virtual size_t write(uint8_t c);
+	using Print::write;
+
+private:
+	FILE* _out;
+	Stream* _stream;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif
@@ -0,0 +1,123 @@
+/**
+ *	frequency stream of BleCommunicator over Rn4020Simulator behind Serial1.
+ *	the handle from LS is written by SHW. without it SUW by uuid is used.
+ *	the frequency characteristic is written only on note changes while streaming
+ */
+#include "Arduino.h"
+#include "BleCommunicator.h"
+#include "Rn4020Simulator.h"
+#include "data_flash_util.h"
+
+#define STREAM_UUID		"12345678901234567890123456789037"
+#define FREQ_UUID		"12345678901234567890123456789033"
+#define STREAM_HEX_LEN	(FREQ_STREAM_PAYLOAD_LEN * 2)
+
+uint8_t g_dataFlash[PFDL_DATA_FLASH_TOTAL_SIZE];
+
+/**
+ *	passes bytes to the simulator and keeps stream writes
+ */
+class Tap : public Stream
+{
+public:
+	Tap() : _len(0), _shw(0), _suw(0), _bad(0), _freq(0) {}
+
+	virtual int available() { return Rn4020Sim.available(); }
+	virtual int read() { return Rn4020Sim.read(); }
+	virtual int peek() { return Rn4020Sim.peek(); }
+	virtual void flush() {}
+	virtual size_t write(uint8_t c)
+	{
+		if (c == '\n') {
+			_line[_len] = '\0';
+			check();
+			_len = 0;
+		}
+		else if (c != '\r' && _len < sizeof(_line) - 1) {
+			_line[_len++] = c;
+		}
+		return Rn4020Sim.write(c);
+	}
+	using Print::write;
+
+	uint16_t _len;
+	uint16_t _shw;		// SHW,0021 with a full batch
+	uint16_t _suw;		// SUW by stream uuid with a full batch
+	uint16_t _bad;		// stream writes otherwise
+	uint16_t _freq;		// SUW by frequency uuid
+	char _line[128];
+
+private:
+	void check()
+	{
+		const char* payload = NULL;
+		if (strncmp(_line, "SHW,", 4) == 0) {
+			payload = (strncmp(_line, "SHW,0021,", 9) == 0) ? &_line[9] : "";
+			_shw += (strlen(payload) == STREAM_HEX_LEN);
+		}
+		else if (strncmp(_line, "SUW," STREAM_UUID ",", 37) == 0) {
+			payload = &_line[37];
+			_suw += (strlen(payload) == STREAM_HEX_LEN);
+		}
+		else if (strncmp(_line, "SUW," FREQ_UUID ",", 37) == 0) {
+			_freq++;
+		}
+		if (payload != NULL && strlen(payload) != STREAM_HEX_LEN) {
+			_bad++;
+		}
+	}
+};
+
+/**
+ *	output of the communicator is dropped
+ */
+class Sink : public Stream
+{
+public:
+	virtual int available() { return 0; }
+	virtual int read() { return -1; }
+	virtual int peek() { return -1; }
+	virtual void flush() {}
+	virtual size_t write(uint8_t c) { return 1; }
+	using Print::write;
+};
+
+static bool run(bool listed)
+{
+	static Sink s_sink;
+	Tap tap;
+	Rn4020Sim.SetLatency(1);
+	Rn4020Sim.SetStreamListed(listed);
+	Serial1.Attach(&tap);
+	Serial.Attach(&s_sink);
+
+	BleCommunicator com;
+	com.Initialize();
+	com.SetBendMode(kBendPitch);
+	com.UpdateFreq(440, 69, 500, (uint16_t)millis());
+	PitchSample_t sample;
+	memset(&sample, 0, sizeof(sample));
+	for (uint8_t i = 0; i < FREQ_STREAM_SAMPLE_NUM * 4; i++) {
+		sample.freq = 440 + i;
+		sample.note = 69;
+		sample.cents = i << 4;
+		// as gr_sketch.cpp posts every frame of the held note
+		com.UpdateFreq(sample.freq, 69, 500, (uint16_t)millis());
+		com.UpdatePitch(&sample);
+		com.Yield();
+	}
+	Serial.Attach(NULL);
+
+	bool ok = (tap._bad == 0) && (tap._freq == 1) && (listed ? (tap._shw == 4 && tap._suw == 0) : (tap._shw == 0 && tap._suw == 4));
+	printf("stream %s LS: SHW %u, SUW %u, bad %u, freq SUW %u %s\n", listed ? "in" : "not in",
+		tap._shw, tap._suw, tap._bad, tap._freq, ok ? "ok" : "NG");
+	return ok;
+}
+
+int main()
+{
+	memset(g_dataFlash, 0xFF, sizeof(g_dataFlash));
+	bool ok = run(true);
+	ok = run(false) && ok;
+	return ok ? 0 : 1;
+}
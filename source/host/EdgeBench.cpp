@@ -0,0 +1,295 @@
+/**
+ *	note-on latency and false triggers of EdgeDetector.
+ *	without arguments frames are synthetic singing generated by a fixed seed
+ *	so that runs are comparable. a trace file captured by TRACE_FRAMES of
+ *	gr_sketch.cpp can be given instead.
+ *	baseline is the EdgeDetector before onset prediction: 3 identical frames
+ *	over the volume hysteresis.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "EdgeDetector.h"
+
+#define SONG_NUM		200
+#define NOTES_PER_SONG	32
+#define LEGATO_RATE		30		// % of notes without a gap before
+#define SCOOP_RATE		25		// % of notes whose first frame is a semitone low
+#define GLITCH_RATE		5		// % of held frames with a wrong pitch
+#define SPIKE_RATE		30		// % of glitches with a volume spike
+
+#define TRACE_FRAME_MAX	4096
+#define TRACE_HELD_MIN	4		// frames of one pitch over the volume hysteresis regarded as sung
+#define TRACE_ON_VOLUME	256		// EdgeDetector default
+
+typedef struct Frame_ {
+	uint16_t truth;		// note being sung. 0 in gaps
+	uint16_t note;		// detected pitch
+	uint16_t volume;
+	Fp_t clarity;
+} Frame_t;
+
+typedef struct Score_ {
+	uint32_t notes;
+	uint32_t missed;		// notes never notified
+	uint32_t latencySum;	// frames from start of a note to its notification
+	uint32_t latencyMax;
+	uint32_t falseOn;		// edges to a note nobody sang
+	uint32_t dropout;		// edges to 0 after a note was notified while it is sung
+} Score_t;
+
+static uint32_t s_seed;
+
+static uint16_t rnd(uint16_t n)
+{
+	// xorshift32
+	s_seed ^= s_seed << 13;
+	s_seed ^= s_seed >> 17;
+	s_seed ^= s_seed << 5;
+	return (uint16_t)(s_seed % n);
+}
+
+static bool chance(uint8_t percent)
+{
+	return rnd(100) < percent;
+}
+
+static Fp_t clarityOf(uint8_t lo, uint8_t hi)
+{
+	// percent range of nsdf peak height
+	return FLOAT2FP((lo + rnd(hi - lo + 1)) / 100.0f);
+}
+
+/**
+ *	@return	number of frames written
+ */
+static uint16_t makeSong(Frame_t* frames, uint16_t capacity)
+{
+	uint16_t n = 0;
+	uint16_t last = 0;
+	for (uint8_t i = 0; i < NOTES_PER_SONG; i++) {
+		uint16_t note = 55 + rnd(20);
+		if (note == last) {
+			note++;
+		}
+		if (i == 0 || !chance(LEGATO_RATE)) {
+			uint8_t gap = 2 + rnd(5);
+			for (uint8_t k = 0; k < gap && n < capacity; k++, n++) {
+				frames[n].truth = 0;
+				frames[n].note = rnd(2) ? 40 + rnd(50) : 0;
+				frames[n].volume = 20 + rnd(40);
+				frames[n].clarity = clarityOf(20, 60);
+			}
+		}
+		uint8_t len = 6 + rnd(20);
+		uint16_t sustain = 400 + rnd(400);
+		for (uint8_t k = 0; k < len && n < capacity; k++, n++) {
+			Frame_t* f = &frames[n];
+			f->truth = note;
+			f->note = note;
+			f->volume = sustain - 32 + rnd(64);
+			f->clarity = clarityOf(88, 99);
+			if (k == 0 && chance(SCOOP_RATE)) {
+				f->note = note - 1;
+				f->clarity = clarityOf(80, 95);
+			}
+			else if (0 < k && chance(GLITCH_RATE)) {
+				f->note = rnd(2) ? note + 12 : note + 1;
+				f->clarity = clarityOf(60, 95);
+				if (chance(SPIKE_RATE)) {
+					f->volume = sustain * 2;
+				}
+			}
+		}
+		last = note;
+	}
+	return n;
+}
+
+/**
+ *	EdgeDetector before onset prediction
+ */
+class BaselineEdgeDetector
+{
+public:
+	BaselineEdgeDetector() : _lastNotifiedVal(0), _vc(256, 128)
+	{
+	}
+
+	bool Input(uint16_t value, uint16_t volume, Fp_t clarity, uint16_t timestamp)
+	{
+		uint16_t voted;
+		uint16_t since;
+		if (!_vc.Input(volume)) {
+			value = 0;
+		}
+		if (_cd.Input(value, timestamp, &voted, &since) && _lastNotifiedVal != voted) {
+			_lastNotifiedVal = voted;
+			return true;
+		}
+		return false;
+	}
+
+	uint16_t CurrentNote()
+	{
+		return _lastNotifiedVal;
+	}
+
+private:
+	uint16_t _lastNotifiedVal;
+	ContinuityDetector<3, 3> _cd;
+	VolumeComparator _vc;
+};
+
+template <class Detector>
+static void run(Detector& det, const Frame_t* frames, uint16_t n, Score_t* score)
+{
+	uint16_t start = 0;		// first frame of the sung note
+	bool notified = false;
+	for (uint16_t t = 0; t < n; t++) {
+		const Frame_t* f = &frames[t];
+		if (t == 0 || frames[t - 1].truth != f->truth) {
+			if (0 < t && frames[t - 1].truth != 0 && !notified) {
+				score->missed++;
+			}
+			if (f->truth != 0) {
+				score->notes++;
+			}
+			start = t;
+			notified = false;
+		}
+
+		bool edge = det.Input(f->note, f->volume, f->clarity, t);
+		uint16_t cur = det.CurrentNote();
+		if (!notified && f->truth != 0 && cur == f->truth) {
+			uint32_t latency = t - start;
+			score->latencySum += latency;
+			if (score->latencyMax < latency) {
+				score->latencyMax = latency;
+			}
+			notified = true;
+		}
+		if (!edge) {
+			continue;
+		}
+		// notes sung within detector's history are not false
+		bool sung = false;
+		for (uint16_t k = 0; k < 3 && k <= t; k++) {
+			if (frames[t - k].truth == cur) {
+				sung = true;
+			}
+		}
+		if (cur != 0 && !sung) {
+			score->falseOn++;
+		}
+		if (cur == 0 && f->truth != 0 && notified) {
+			score->dropout++;
+		}
+	}
+	if (0 < n && frames[n - 1].truth != 0 && !notified) {
+		score->missed++;
+	}
+}
+
+/**
+ *	every detector on one song
+ */
+static void runAll(const Frame_t* frames, uint16_t n, Score_t* scores)
+{
+	BaselineEdgeDetector baseline;
+	EdgeDetector<3, 3> strict;
+	EdgeDetector<3, 2> voting;
+	EdgeDetector<3, 3> strictOnset;
+	EdgeDetector<3, 2> votingOnset;
+	strictOnset.SetPrediction(true);
+	votingOnset.SetPrediction(true);
+	run(baseline, frames, n, &scores[0]);
+	run(strict, frames, n, &scores[1]);
+	run(voting, frames, n, &scores[2]);
+	run(strictOnset, frames, n, &scores[3]);
+	run(votingOnset, frames, n, &scores[4]);
+}
+
+/**
+ *	one frame per line: timestamp note volume clarity(raw Fp_t). '#' starts a comment.
+ *	there is no ground truth in a capture. a pitch held TRACE_HELD_MIN frames
+ *	over the volume hysteresis is regarded as sung from its first frame.
+ *	@return	number of frames read
+ */
+static uint16_t loadTrace(const char* path, Frame_t* frames, uint16_t capacity)
+{
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL) {
+		return 0;
+	}
+	char line[64];
+	uint16_t n = 0;
+	while (n < capacity && fgets(line, sizeof(line), fp) != NULL) {
+		unsigned int timestamp, note, volume;
+		int clarity;
+		if (line[0] == '#' || sscanf(line, "%u %u %u %d", &timestamp, &note, &volume, &clarity) != 4) {
+			continue;
+		}
+		frames[n].truth = 0;
+		frames[n].note = (uint16_t)note;
+		frames[n].volume = (uint16_t)volume;
+		frames[n].clarity = (Fp_t)clarity;
+		n++;
+	}
+	fclose(fp);
+
+	uint16_t start = 0;
+	for (uint16_t t = 1; t <= n; t++) {
+		if (t < n && frames[t].note == frames[start].note && TRACE_ON_VOLUME <= frames[t].volume) {
+			continue;
+		}
+		bool held = frames[start].note != 0 && TRACE_ON_VOLUME <= frames[start].volume;
+		if (held && TRACE_HELD_MIN <= t - start) {
+			for (uint16_t k = start; k < t; k++) {
+				frames[k].truth = frames[start].note;
+			}
+		}
+		start = t;
+	}
+	return n;
+}
+
+static void report(const char* name, const Score_t* score)
+{
+	uint32_t hit = score->notes - score->missed;
+	printf("%-16s notes %5lu  missed %4lu  latency mean %4.2f max %2lu frames  false on %4lu  dropout %4lu\n",
+		name,
+		(unsigned long)score->notes,
+		(unsigned long)score->missed,
+		hit ? (double)score->latencySum / hit : 0.0,
+		(unsigned long)score->latencyMax,
+		(unsigned long)score->falseOn,
+		(unsigned long)score->dropout);
+}
+
+int main(int argc, char* argv[])
+{
+	static Frame_t frames[TRACE_FRAME_MAX];
+	static const char* names[] = { "baseline 3/3", "vote 3/3", "vote 2/3", "onset 3/3", "onset 2/3" };
+	Score_t scores[sizeof(names) / sizeof(names[0])] = {{0}};
+
+	if (1 < argc) {
+		uint16_t n = loadTrace(argv[1], frames, TRACE_FRAME_MAX);
+		if (n == 0) {
+			printf("no frames in %s\n", argv[1]);
+			return 1;
+		}
+		printf("%s: %u frames\n", argv[1], n);
+		runAll(frames, n, scores);
+	}
+	else {
+		s_seed = 2463534242UL;
+		for (uint16_t i = 0; i < SONG_NUM; i++) {
+			uint16_t n = makeSong(frames, NOTES_PER_SONG * 32);
+			runAll(frames, n, scores);
+		}
+	}
+	for (uint8_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		report(names[i], &scores[i]);
+	}
+	return 0;
+}
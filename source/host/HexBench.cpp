@@ -0,0 +1,108 @@
+/**
+ *	hex encoding of a 20 byte BLE-MIDI packet, hexUi8 against itoaUi16 it replaced.
+ *	itoa is the digit loop of newlib that RLduino78 links.
+ *	cycles are of the host tsc, not of RL78. they tell the ratio, not the time on the board
+ */
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_TSC
+#endif
+#include "Arduino.h"
+#include "StringUtility.h"
+
+#define BENCH_PACKETS	200000
+#define BENCH_PACKET_LEN	20
+
+static char* newlibItoa(int value, char* str, int base)
+{
+	static const char kDigits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+	unsigned int uvalue = (value < 0 && base == 10) ? -value : value;
+	int i = 0;
+	if (value < 0 && base == 10) {
+		str[i++] = '-';
+	}
+	int first = i;
+	do {
+		str[i++] = kDigits[uvalue % base];
+		uvalue /= base;
+	} while (uvalue != 0);
+	str[i] = '\0';
+	for (int j = i - 1; first < j; first++, j--) {
+		char c = str[first];
+		str[first] = str[j];
+		str[j] = c;
+	}
+	return str;
+}
+
+/**
+ *	removed from StringUtility.cpp by user-048
+ */
+static void itoaUi16(uint16_t val, char* output)
+{
+	char buf[16] = {0};
+	newlibItoa((int)val, buf, 16);
+
+	if (strlen(buf) == 1) {
+		output[0] = '0';
+		output[1] = buf[0];
+	} else {
+		output[0] = buf[0];
+		output[1] = buf[1];
+	}
+}
+
+static double nowNs()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static uint64_t nowCycles()
+{
+#if defined(HAS_TSC)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+int main()
+{
+	uint8_t packet[BENCH_PACKET_LEN];
+	char out[BENCH_PACKET_LEN * 2 + 1];
+	volatile char sink = 0;
+	for (uint8_t i = 0; i < BENCH_PACKET_LEN; i++) {
+		packet[i] = (uint8_t)(i * 37 + 11);
+	}
+
+	for (uint8_t pass = 0; pass < 2; pass++) {
+		double start = nowNs();
+		uint64_t startCycles = nowCycles();
+		for (uint32_t n = 0; n < BENCH_PACKETS; n++) {
+			packet[0] = (uint8_t)n;
+			char* hex = out;
+			for (uint8_t i = 0; i < BENCH_PACKET_LEN; i++, hex += 2) {
+				if (pass == 0) {
+					itoaUi16(packet[i], hex);
+				}
+				else {
+					hexUi8(packet[i], hex);
+				}
+			}
+			*hex = '\0';
+			sink += out[n % (BENCH_PACKET_LEN * 2)];
+		}
+		double cycles = (double)(nowCycles() - startCycles) / BENCH_PACKETS;
+		double ns = (nowNs() - start) / BENCH_PACKETS;
+		printf("%-9s %7.1f ns per packet, %5.2f per byte", (pass == 0) ? "itoaUi16" : "hexUi8", ns, ns / BENCH_PACKET_LEN);
+#if defined(HAS_TSC)
+		printf(", %7.1f tsc cycles per packet, %5.2f per byte", cycles, cycles / BENCH_PACKET_LEN);
+#endif
+		printf("\n");
+	}
+	return 0;
+}
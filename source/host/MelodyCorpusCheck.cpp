@@ -0,0 +1,145 @@
+/**
+ *	runs MelodyCorpus.txt through MelodyCommandReceiver in interval mode.
+ *	every line is checked with tolerance 0(automaton) and 1(MelodyDetector per command)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "MelodyCommandReceiver.h"
+
+#define CORPUS_LINE_MAX		256
+#define CORPUS_NOTE_MAX		32
+#define COMMAND_NAME_MAX	8
+#define TOLERANCE_MAX		1
+
+typedef struct Entry_ {
+	int expected;		// command index. -1 if none
+	uint8_t tolerance;
+	uint16_t notes[CORPUS_NOTE_MAX];
+	uint8_t noteNum;
+	int line;
+} Entry_t;
+
+static char s_names[MELODY_COMMAND_MAX][COMMAND_NAME_MAX];
+static uint16_t s_melodies[MELODY_COMMAND_MAX][2][MAX_MELODY_LENGTH];
+static MelodyCommand_t s_commands[MELODY_COMMAND_MAX];
+static uint8_t s_commandNum;
+static Entry_t s_entries[128];
+static uint16_t s_entryNum;
+
+static uint8_t parseNotes(char* str, uint16_t* notes, uint8_t max)
+{
+	uint8_t n = 0;
+	for (char* tok = strtok(str, " \t\r\n"); tok != NULL && n < max; tok = strtok(NULL, " \t\r\n")) {
+		notes[n++] = (uint16_t)atoi(tok);
+	}
+	return n;
+}
+
+static int commandOf(const char* name)
+{
+	for (uint8_t i = 0; i < s_commandNum; i++) {
+		if (strcmp(s_names[i], name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static bool load(const char* path)
+{
+	FILE* fp = fopen(path, "r");
+	if (fp == NULL) {
+		printf("can't open %s\n", path);
+		return false;
+	}
+	char buf[CORPUS_LINE_MAX];
+	char name[COMMAND_NAME_MAX];
+	int line = 0;
+	while (fgets(buf, sizeof(buf), fp) != NULL) {
+		line++;
+		if (buf[0] == '#' || strspn(buf, " \t\r\n") == strlen(buf)) {
+			continue;
+		}
+		if (strncmp(buf, "command ", 8) == 0 && s_commandNum < MELODY_COMMAND_MAX) {
+			char* bar = strchr(buf, '|');
+			if (bar == NULL || sscanf(buf + 8, "%7s", s_names[s_commandNum]) != 1) {
+				printf("line %d: bad command\n", line);
+				return false;
+			}
+			*bar = '\0';
+			char* melody0 = strstr(buf + 8, s_names[s_commandNum]) + strlen(s_names[s_commandNum]);
+			MelodyCommand_t* cmd = &s_commands[s_commandNum];
+			cmd->melody0_len = parseNotes(melody0, s_melodies[s_commandNum][0], MAX_MELODY_LENGTH);
+			cmd->melody1_len = parseNotes(bar + 1, s_melodies[s_commandNum][1], MAX_MELODY_LENGTH);
+			cmd->melody0 = s_melodies[s_commandNum][0];
+			cmd->melody1 = s_melodies[s_commandNum][1];
+			s_commandNum++;
+			continue;
+		}
+		char* colon = strchr(buf, ':');
+		int tolerance;
+		if (colon == NULL || sscanf(buf, "%7s %d", name, &tolerance) != 2 || s_entryNum == sizeof(s_entries) / sizeof(s_entries[0])) {
+			printf("line %d: bad entry\n", line);
+			return false;
+		}
+		Entry_t* e = &s_entries[s_entryNum++];
+		e->expected = (strcmp(name, "-") == 0) ? -1 : commandOf(name);
+		if (e->expected < 0 && strcmp(name, "-") != 0) {
+			printf("line %d: unknown command %s\n", line, name);
+			return false;
+		}
+		e->tolerance = (uint8_t)tolerance;
+		e->noteNum = parseNotes(colon + 1, e->notes, CORPUS_NOTE_MAX);
+		e->line = line;
+	}
+	fclose(fp);
+	return true;
+}
+
+/**
+ *	@return	index of the first command fired. -1 if none
+ */
+static int fired(const Entry_t* e, uint8_t tolerance)
+{
+	static MelodyCommandReceiver receiver;
+	receiver = MelodyCommandReceiver();
+	if (!receiver.Initialize(s_commands, s_commandNum, kMelodyMatchInterval, tolerance)) {
+		printf("can't initialize commands\n");
+		exit(1);
+	}
+	for (uint8_t i = 0; i < e->noteNum; i++) {
+		MelodyCommandResponse_t resp = receiver.Input(e->notes[i]);
+		if (resp.evt == kMelodyCommandEvtFired) {
+			return resp.commandIdx;
+		}
+	}
+	return -1;
+}
+
+int main(int argc, char* argv[])
+{
+	if (!load((1 < argc) ? argv[1] : "MelodyCorpus.txt")) {
+		return 1;
+	}
+
+	int failed = 0;
+	for (uint8_t tolerance = 0; tolerance <= TOLERANCE_MAX; tolerance++) {
+		int pass = 0;
+		for (uint16_t i = 0; i < s_entryNum; i++) {
+			const Entry_t* e = &s_entries[i];
+			int expected = (e->tolerance <= tolerance) ? e->expected : -1;
+			int result = fired(e, tolerance);
+			if (result == expected) {
+				pass++;
+			}
+			else {
+				printf("line %d tolerance %u: expected %s got %s\n", e->line, tolerance,
+					(expected < 0) ? "-" : s_names[expected], (result < 0) ? "-" : s_names[result]);
+			}
+		}
+		printf("interval tolerance %u: %d / %u passed\n", tolerance, pass, s_entryNum);
+		failed += s_entryNum - pass;
+	}
+	return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+/**
+ *	MelodyStore::Load() over store images in the ram data flash.
+ *	crc is right in every image so that only the field checks reject them
+ */
+#include <stdio.h>
+#include "MelodyStore.h"
+#include "data_flash_util.h"
+
+uint8_t g_dataFlash[PFDL_DATA_FLASH_TOTAL_SIZE];
+
+static uint16_t crc16(const uint8_t* data, uint16_t len)
+{
+	// crc16-ccitt as MelodyStore.cpp
+	uint16_t crc = 0xFFFF;
+	for (uint16_t i = 0; i < len; i++) {
+		crc ^= (uint16_t)data[i] << 8;
+		for (uint8_t k = 0; k < 8; k++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+/**
+ *	writes header and body as the phone does, in 20 byte pieces
+ */
+static void writeStore(uint8_t commandNum, uint8_t responseNum, const uint8_t* body, uint16_t bodyLen)
+{
+	uint8_t image[MELODY_STORE_SIZE];
+	uint16_t crc = crc16(body, bodyLen);
+	uint8_t header[] = { 'M', 'S', 1, commandNum, responseNum, 0,
+		(uint8_t)bodyLen, (uint8_t)(bodyLen >> 8), (uint8_t)crc, (uint8_t)(crc >> 8) };
+	memcpy(image, header, sizeof(header));
+	memcpy(&image[sizeof(header)], body, bodyLen);
+	uint16_t len = sizeof(header) + bodyLen;
+	for (uint16_t offset = 0; offset < len; offset += 20) {
+		uint8_t n = (uint8_t)((20 < len - offset) ? 20 : len - offset);
+		MelodyStore.Write(offset, &image[offset], n);
+	}
+}
+
+static int s_failed = 0;
+
+static void check(const char* name, bool expected)
+{
+	bool result = MelodyStore.Load();
+	printf("%-28s %s\n", name, (result == expected) ? "ok" : "NG");
+	if (result != expected) {
+		s_failed++;
+	}
+}
+
+int main()
+{
+	memset(g_dataFlash, 0xFF, sizeof(g_dataFlash));
+	check("blank", false);
+
+	// command G D Bb A / A D, response ch 1 C 100ms E 200ms
+	const uint8_t valid[] = { 4, 2, 67, 74, 70, 69, 69, 62, 1, 2, 60, 100, 0, 64, 200, 0 };
+	uint8_t body[sizeof(valid)];
+
+	writeStore(1, 1, valid, sizeof(valid));
+	check("valid", true);
+	MelodyCommand_t cmd = { NULL, NULL, 0, 0 };
+	MelodyStore.OverrideCommands(&cmd, 1);
+	if (cmd.melody0_len != 4 || cmd.melody0[3] != 69 || cmd.melody1[1] != 62) {
+		printf("commands not overridden\n");
+		s_failed++;
+	}
+
+	memcpy(body, valid, sizeof(body));
+	body[8] = 16;
+	writeStore(1, 1, body, sizeof(body));
+	check("response ch 16", false);
+
+	memcpy(body, valid, sizeof(body));
+	body[10] = 128;
+	writeStore(1, 1, body, sizeof(body));
+	check("response note 128", false);
+
+	memcpy(body, valid, sizeof(body));
+	body[3] = 200;
+	writeStore(1, 1, body, sizeof(body));
+	check("command note 200", false);
+
+	const uint8_t empty0[] = { 0, 2, 69, 62 };
+	writeStore(1, 0, empty0, sizeof(empty0));
+	check("melody0 of no note", false);
+
+	const uint8_t single0[] = { 1, 2, 67, 69, 62 };
+	writeStore(1, 0, single0, sizeof(single0));
+	check("melody0 of 1 note", false);
+
+	return (s_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+/**
+ *	BLE-MIDI path over Rn4020Simulator behind Serial1.
+ *	measures connect and reconnect time, time and latency of note changes.
+ *	bend mode checks that vibrato with pressure stays in the streaming budget
+ *	of BleMidiCommunicator.
+ *	usage: Rn4020Bench [latency ms] [error interval]
+ *	       Rn4020Bench bend [latency ms]
+ */
+#include <math.h>
+#include "Arduino.h"
+#include "Rn4020Controller.h"
+#include "Rn4020Simulator.h"
+#include "BleMidiPacket.h"
+#include "BleMidiCommunicator.h"
+#include "OsakanaPitchDetectionCommon.h"
+#include "data_flash_util.h"
+
+#define BENCH_NOTE_CHANGES	200
+#define BENCH_CHANNELS		6
+#define BENCH_TIMEOUT_MS	20000
+
+#define BENCH_BEND_MS		5000
+#define BENCH_FRAME_MS		30
+#define BENCH_VIBRATO_MS	200		// 5 Hz
+#define BENCH_VIBRATO_CENTS	30
+#define BENCH_TREMOLO		100		// volume swing. pressure is volume >> 3
+#define BENCH_BEND_BUDGET	(1000 / BEND_MS_PER_BYTE)	// bytes per second
+
+uint8_t g_dataFlash[PFDL_DATA_FLASH_TOTAL_SIZE];
+
+static Rn4020Controller s_ble(Serial1);
+static BleMidiPacket s_packet;
+
+/**
+ *	@return	ms until event. 0 on timeout
+ */
+static unsigned long waitEvent(uint32_t evt)
+{
+	unsigned long start = millis();
+	while (s_ble.Yield() != evt) {
+		delay(1);
+		if (BENCH_TIMEOUT_MS < millis() - start) {
+			return 0;
+		}
+	}
+	return millis() - start;
+}
+
+static void add(uint8_t status, uint8_t note)
+{
+	if (!s_packet.Add((uint16_t)millis(), status, note, 127, 2)) {
+		s_ble.WriteCharacteristic(s_packet.Data(), s_packet.Length());
+		s_packet.Clear();
+		s_packet.Add((uint16_t)millis(), status, note, 127, 2);
+	}
+}
+
+/**
+ *	one held note of kInstOrc(6 channels) with vibrato and tremolo.
+ *	payload counted by the simulator includes BLE-MIDI headers and timestamps.
+ *	note on/off are not in the budget and left out
+ *	@return	true if within budget
+ */
+static bool benchBend(BleMidiCommunicator& com, uint8_t mode)
+{
+	com.SetBendMode(mode);
+	com.UpdateFreq(440, 69, 500, (uint16_t)millis());
+	// let note on leave the write pipeline
+	for (uint8_t i = 0; i < 10; i++) {
+		com.Yield();
+		delay(BENCH_FRAME_MS);
+	}
+
+	uint32_t bytes = Rn4020Sim.Stats()->midiBytes;
+	uint32_t errors = Rn4020Sim.Stats()->errors;
+	unsigned long start = millis();
+	PitchSample_t sample;
+	memset(&sample, 0, sizeof(sample));
+	while (millis() - start < BENCH_BEND_MS) {
+		double phase = 2 * M_PI * (millis() - start) / BENCH_VIBRATO_MS;
+		sample.cents = (int16_t)(BENCH_VIBRATO_CENTS * sin(phase)) << CENTS_SHFT;
+		sample.volume = 500 + (int16_t)(BENCH_TREMOLO * sin(phase));
+		sample.timestamp = (uint16_t)millis();
+		sample.note = 69;
+		com.PostPitch(&sample);
+		com.Yield();
+		delay(BENCH_FRAME_MS);
+	}
+	unsigned long rate = (Rn4020Sim.Stats()->midiBytes - bytes) * 1000UL / BENCH_BEND_MS;
+	com.UpdateFreq(0, 0, 0, (uint16_t)millis());
+	com.Yield();
+
+	bool ok = (rate <= BENCH_BEND_BUDGET);
+	printf("bend mode %u: %lu B/s of %u B/s, errors %lu %s\n", mode, rate, BENCH_BEND_BUDGET,
+		(unsigned long)(Rn4020Sim.Stats()->errors - errors), ok ? "ok" : "NG");
+	return ok;
+}
+
+/**
+ *	@return	false if response melody doesn't end
+ */
+static bool waitPlayback(BleMidiCommunicator& com)
+{
+	unsigned long start = millis();
+	while (com.IsPlaying()) {
+		com.Yield();
+		delay(1);
+		if (BENCH_TIMEOUT_MS < millis() - start) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static int mainBend(uint16_t latency)
+{
+	static BleMidiCommunicator s_com;
+	memset(g_dataFlash, 0xFF, sizeof(g_dataFlash));
+	Rn4020Sim.SetLatency(latency);
+	Serial1.Attach(&Rn4020Sim);
+
+	s_com.Initialize();
+	unsigned long start = millis();
+	// instruments and boot melody follow the connection
+	while (Rn4020Sim.Stats()->midiBytes == 0) {
+		s_com.Yield();
+		delay(1);
+		if (BENCH_TIMEOUT_MS < millis() - start) {
+			printf("no connection\n");
+			return 1;
+		}
+	}
+	s_com.ChangeInst(kInstOrc);
+	if (!waitPlayback(s_com)) {
+		printf("playback doesn't end\n");
+		return 1;
+	}
+
+	bool ok = benchBend(s_com, kBendOff);
+	ok = benchBend(s_com, kBendPitch) && ok;
+	ok = benchBend(s_com, kBendPitchPressure) && ok;
+	return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+	if (1 < argc && strcmp(argv[1], "bend") == 0) {
+		return mainBend((2 < argc) ? atoi(argv[2]) : 10);
+	}
+	Rn4020Sim.SetLatency((1 < argc) ? atoi(argv[1]) : 10);
+	Rn4020Sim.SetErrorInterval((2 < argc) ? atoi(argv[2]) : 0);
+	Serial1.Attach(&Rn4020Sim);
+
+	s_ble.Initialize();
+	unsigned long connect = waitEvent(kRn4020EvtConnected);
+	if (connect == 0) {
+		printf("no connection\n");
+		return 1;
+	}
+	printf("connected in %lu ms\n", connect);
+
+	// every channel moves from one note to next at once
+	unsigned long start = millis();
+	for (uint16_t i = 0; i < BENCH_NOTE_CHANGES; i++) {
+		for (uint8_t ch = 0; ch < BENCH_CHANNELS; ch++) {
+			add(0x80 | ch, 60 + (i & 7));
+		}
+		for (uint8_t ch = 0; ch < BENCH_CHANNELS; ch++) {
+			add(0x90 | ch, 60 + ((i + 1) & 7));
+		}
+		s_ble.WriteCharacteristic(s_packet.Data(), s_packet.Length());
+		s_packet.Clear();
+		s_ble.Yield();
+	}
+	printf("%u note changes of %u channels in %lu ms\n", BENCH_NOTE_CHANGES, BENCH_CHANNELS, millis() - start);
+	Rn4020Sim.PrintStats(Serial);
+
+	Rn4020Sim.Disconnect();
+	if (waitEvent(kRn4020EvtDisconnected) == 0) {
+		printf("no disconnection\n");
+		return 1;
+	}
+	unsigned long reconnect = waitEvent(kRn4020EvtConnected);
+	if (reconnect == 0) {
+		printf("no reconnection\n");
+		return 1;
+	}
+	printf("reconnected in %lu ms\n", reconnect);
+	return 0;
+}
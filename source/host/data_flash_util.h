@@ -0,0 +1,57 @@
+/**
+ *	host stand-in of RLduino78 data_flash_util.h. data flash is a ram image
+ *	that starts blank(0xFF) like the erased device
+ */
+#ifndef _HOST_DATA_FLASH_UTIL_H_
+#define _HOST_DATA_FLASH_UTIL_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PFDL_DATA_FLASH_BLOCK_SIZE		1024
+#define PFDL_DATA_FLASH_NUM_OF_BLOCKS	8
+#define PFDL_DATA_FLASH_TOTAL_SIZE		(PFDL_DATA_FLASH_BLOCK_SIZE * PFDL_DATA_FLASH_NUM_OF_BLOCKS)
+
+typedef uint8_t pfdl_status_t;
+#define PFDL_OK			0x00
+#define PFDL_ERR_PARAMETER	0x05
+
+extern uint8_t g_dataFlash[PFDL_DATA_FLASH_TOTAL_SIZE];
+
+inline pfdl_status_t pfdl_open(void)
+{
+	return PFDL_OK;
+}
+
+inline void pfdl_close(void)
+{
+}
+
+inline pfdl_status_t pfdl_erase_block(uint16_t u16BlockNumber)
+{
+	if (PFDL_DATA_FLASH_NUM_OF_BLOCKS <= u16BlockNumber) {
+		return PFDL_ERR_PARAMETER;
+	}
+	memset(&g_dataFlash[u16BlockNumber * PFDL_DATA_FLASH_BLOCK_SIZE], 0xFF, PFDL_DATA_FLASH_BLOCK_SIZE);
+	return PFDL_OK;
+}
+
+inline pfdl_status_t pfdl_write(uint16_t u16Address, uint8_t* pu8Data, uint16_t u16Length)
+{
+	if (PFDL_DATA_FLASH_TOTAL_SIZE < (uint32_t)u16Address + u16Length) {
+		return PFDL_ERR_PARAMETER;
+	}
+	memcpy(&g_dataFlash[u16Address], pu8Data, u16Length);
+	return PFDL_OK;
+}
+
+inline pfdl_status_t pfdl_read(uint16_t u16Address, uint8_t* pu8Data, uint16_t u16Length)
+{
+	if (PFDL_DATA_FLASH_TOTAL_SIZE < (uint32_t)u16Address + u16Length) {
+		return PFDL_ERR_PARAMETER;
+	}
+	memcpy(pu8Data, &g_dataFlash[u16Address], u16Length);
+	return PFDL_OK;
+}
+
+#endif
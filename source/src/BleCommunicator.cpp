@@ -1,14 +1,19 @@
 #include "BleCommunicator.h"
 #include "Arduino.h"
+#include "MelodyStore.h"
+#include "Rn4020Simulator.h"
 
 #define LOG     Serial
-#define RN4020  Serial1
+#define RN4020  RN4020_PORT
 
 #define DEBUG(...) { char debug_buf[256] = {0}; snprintf(debug_buf, sizeof(debug_buf), __VA_ARGS__); LOG.println(debug_buf); }
 
 #define UUID_TUNER_SERVICE		"123456789012345678901234567890FF"
 #define UUID_FREQ_CHAR			"12345678901234567890123456789033"
 #define UUID_GAIN_CHAR			"12345678901234567890123456789034"
+#define UUID_TUNING_CHAR		"12345678901234567890123456789035"
+#define UUID_MELODY_CHAR		"12345678901234567890123456789036"
+#define UUID_STREAM_CHAR		"12345678901234567890123456789037"
 
 #define CMD_FACTORY_RESET		"SF,1"
 #define CMD_FUNCTIONS			"SR,24000000"
@@ -19,6 +24,12 @@
 #define CMD_PRIVATE_SERVICE		"PS," UUID_TUNER_SERVICE
 #define CMD_PRIVATE_CHAR0		"PC," UUID_FREQ_CHAR ",12,04"
 #define CMD_PRIVATE_CHAR1		"PC," UUID_GAIN_CHAR ",06,04"
+#define CMD_PRIVATE_CHAR2		"PC," UUID_TUNING_CHAR ",06,04"
+#define CMD_PRIVATE_CHAR3		"PC," UUID_MELODY_CHAR ",08,14"
+#define CMD_PRIVATE_CHAR4		"PC," UUID_STREAM_CHAR ",10,14"	// added last not to move handles above
+#define CMD_LIST_SERVICES		"LS"
+#define LIST_END				"END"
+#define STREAM_CMD_TEMPLATE		"SHW,0000,"
 #define CMD_VER_FW				"SDF,0.1"
 #define CMD_VER_DEV				"SDH,0.1"
 #define CMD_VER_SW				"SDR,0.1"
@@ -37,6 +48,9 @@ typedef struct _SerialCommand {
 	const int timeout;
 } SerialCommand_t;
 
+// melody characteristic is 20 bytes. 2 of them are offset
+#define MELODY_WRITE_MAX		18
+
 static const int kCmdRetry = 3;
 static const char* kOk = "AOK";
 static const char* kErr = "ERR";
@@ -52,6 +66,9 @@ static const SerialCommand_t kInitCommands[] = {
 	{CMD_PRIVATE_SERVICE,	_strlen(CMD_PRIVATE_SERVICE),	kOk, kErr, 100},
 	{CMD_PRIVATE_CHAR0,		_strlen(CMD_PRIVATE_CHAR0),		kOk, kErr, 100},
 	{CMD_PRIVATE_CHAR1,		_strlen(CMD_PRIVATE_CHAR1),		kOk, kErr, 100},
+	{CMD_PRIVATE_CHAR2,		_strlen(CMD_PRIVATE_CHAR2),		kOk, kErr, 100},
+	{CMD_PRIVATE_CHAR3,		_strlen(CMD_PRIVATE_CHAR3),		kOk, kErr, 100},
+	{CMD_PRIVATE_CHAR4,		_strlen(CMD_PRIVATE_CHAR4),		kOk, kErr, 100},
 	{CMD_VER_FW,			_strlen(CMD_VER_FW),			kOk, kErr, 100},
 	{CMD_VER_DEV,			_strlen(CMD_VER_DEV),			kOk, kErr, 100},
 	{CMD_VER_SW,			_strlen(CMD_VER_SW),			kOk, kErr, 100},
@@ -61,7 +78,15 @@ static const SerialCommand_t kInitCommands[] = {
 };
 
 BleCommunicator::BleCommunicator()
+:
+_serial(RN4020),
+_streamEnabled(false),
+_streamFound(false),
+_streamNum(0),
+_streamSeq(0),
+_streamFirst(0)
 {
+    strcpy(_streamCmd, STREAM_CMD_TEMPLATE);
 }
 
 /**
@@ -83,6 +108,9 @@ uint32_t BleCommunicator::Initialize()
             break;
         }
     }
+    if(!findStreamHandle()) {
+        DEBUG("stream handle unknown. written by uuid");
+    }
 	
     DEBUG("%s EXT", __FUNCTION__);
     return 0;
@@ -90,20 +118,18 @@ uint32_t BleCommunicator::Initialize()
 
 bool BleCommunicator::initializeDevice()
 {
-	for(int i = 0; i < _countof(kInitCommands); i++) {
+	for(uint8_t i = 0; i < _countof(kInitCommands); i++) {
 		purge();
 		
 		const SerialCommand_t* pCmd = &kInitCommands[i];
-		RN4020.setTimeout(pCmd->timeout);
+		_serial.SetTimeout(pCmd->timeout);
 		
 		const char* cmd = pCmd->cmd;
 		LOG.println(cmd);
-		RN4020.println(cmd);
+		_serial.PrintLn(cmd);
 		
-		String recv = RN4020.readStringUntil('\n');
-		LOG.println("received:");
-		LOG.println(recv);
-		if(recv.startsWith(pCmd->resp_ok)) {
+		StrView_t recv;
+		if(_serial.ReadLine(&recv) && viewStartsWith(&recv, pCmd->resp_ok)) {
 			LOG.println("success");
 		} else {
 			LOG.println("fail");
@@ -113,20 +139,54 @@ bool BleCommunicator::initializeDevice()
 	return true;
 }
 
-void BleCommunicator::purge()
+/**
+ *  server services are listed by LS in the layout of LC, which
+ *  Rn4020Controller reads from the module
+ *    service uuid
+ *      char uuid,handle,property
+ *    END
+ *  a notified char has another line of its configuration handle after the value.
+ *  fields after property are ignored
+ */
+bool BleCommunicator::findStreamHandle()
 {
-    RN4020.begin(115200);
-    while(RN4020.available() > 0) {
-        char c = RN4020.read();
-        LOG.print(c);
-        delay(10);
+    purge();
+    _serial.SetTimeout(1000);
+    _serial.PrintLn(CMD_LIST_SERVICES);
+    
+    StrView_t line;
+    while(_serial.ReadLine(&line) && !viewEquals(&line, LIST_END)) {
+        if(_streamFound) {
+            continue;
+        }
+        StrView_t words[4];
+        if(splitCommaSeparated(line.str, line.len, words, _countof(words)) < 3) {
+            continue;
+        }
+        // uuid is indented
+        while(words[0].len != 0 && words[0].str[0] == ' ') {
+            words[0].str++;
+            words[0].len--;
+        }
+        if(viewEquals(&words[0], UUID_STREAM_CHAR) && words[1].len == 4
+            && isxdigit(words[1].str[0]) && isxdigit(words[1].str[3])) {
+            memcpy(&_streamCmd[4], words[1].str, 4);
+            _streamFound = true;
+        }
     }
+    return _streamFound;
 }
 
-void BleCommunicator::UpdateFreq(uint16_t freq, uint16_t note)
+void BleCommunicator::purge()
+{
+    _serial.Purge();
+}
+
+void BleCommunicator::UpdateFreq(uint16_t freq, uint16_t note, uint16_t volume, uint16_t timestamp)
 {
     DEBUG("%s ENT", __FUNCTION__);
-    if(_pitchVal[0] == freq && _pitchVal[1] == note) {
+    // the stream carries freq of the held note. only edges are written by uuid
+    if(_pitchVal[1] == note && (_streamEnabled || _pitchVal[0] == freq)) {
         DEBUG("%s EXT", __FUNCTION__);
         return;
     }
@@ -138,7 +198,7 @@ void BleCommunicator::UpdateFreq(uint16_t freq, uint16_t note)
     DEBUG("%s freq=%d, note=%d sent", __FUNCTION__, freq, note);
     
     _pitchVal[0] = pitch[0];
-    _pitchVal[1] = pitch[2];
+    _pitchVal[1] = pitch[1];
     RN4020.print("SUW," UUID_FREQ_CHAR ",");
     
     char buf[9] = {'\0'};
@@ -148,24 +208,111 @@ void BleCommunicator::UpdateFreq(uint16_t freq, uint16_t note)
     
     // read response
     recvCommand();
+    
+    if(note == 0 && _streamNum != 0) {
+        // last samples of the note
+        sendStream();
+    }
 		
     DEBUG("%s EXT", __FUNCTION__);
 }
 
+/**
+ *  any mode but kBendOff streams samples of the held note
+ */
+void BleCommunicator::SetBendMode(uint8_t mode)
+{
+    _streamEnabled = (mode != kBendOff);
+}
+
+/**
+ *  payload: seq(4 bits) << 4 | sample num, then
+ *  freq(LE16), note, cents(LE16, 1/16 cent), clarity(nsdf height >> 6) per sample
+ */
+void BleCommunicator::UpdatePitch(const PitchSample_t* sample)
+{
+    if(!_streamEnabled) {
+        return;
+    }
+    if(_streamNum == 0) {
+        _streamFirst = millis();
+    }
+    uint8_t* p = &_streamBuf[1 + _streamNum * FREQ_STREAM_SAMPLE_LEN];
+    p[0] = (uint8_t)sample->freq;
+    p[1] = (uint8_t)(sample->freq >> 8);
+    p[2] = sample->note;
+    p[3] = (uint8_t)sample->cents;
+    p[4] = (uint8_t)((uint16_t)sample->cents >> 8);
+    p[5] = (uint8_t)constrain(sample->clarity >> 6, 0, 0xFF);
+    _streamNum++;
+    
+    if(_streamNum == FREQ_STREAM_SAMPLE_NUM) {
+        sendStream();
+    }
+}
+
+/**
+ *  SHW by handle, or SUW by uuid if LS didn't give the handle.
+ *  response is read later by recvCommand()
+ */
+void BleCommunicator::sendStream()
+{
+    _streamBuf[0] = (uint8_t)((_streamSeq << 4) | _streamNum);
+    _streamSeq = (_streamSeq + 1) & 0x0F;
+    
+    char* hex = &_streamCmd[9];
+    for(uint8_t i = 0; i < 1 + _streamNum * FREQ_STREAM_SAMPLE_LEN; i++) {
+        hexUi8(_streamBuf[i], hex);
+        hex += 2;
+    }
+    *hex = '\0';
+    if(_streamFound) {
+        _serial.PrintLn(_streamCmd);
+    } else {
+        RN4020.print("SUW," UUID_STREAM_CHAR ",");
+        _serial.PrintLn(&_streamCmd[9]);
+    }
+    _streamNum = 0;
+}
+
 uint8_t BleCommunicator::GetGain()
 {
     return _gainVal;
 }
 
+/**
+ *  oooo + data in hex. oooo is offset in melody store
+ */
+static void writeMelodyStore(const char* hex)
+{
+    uint8_t data[MELODY_WRITE_MAX];
+    char word[5] = {0};
+    snprintf(word, sizeof(word), "%.4s", hex);
+    uint16_t offset = (uint16_t)strtoul(word, NULL, 16);
+    hex += 4;
+
+    uint8_t len = 0;
+    word[2] = '\0';
+    while(len < MELODY_WRITE_MAX && isxdigit(hex[0]) && isxdigit(hex[1])) {
+        word[0] = hex[0];
+        word[1] = hex[1];
+        data[len++] = (uint8_t)strtoul(word, NULL, 16);
+        hex += 2;
+    }
+    if(MelodyStore.Write(offset, data, len)) {
+        DEBUG("melody store %u bytes at %u", len, offset);
+    }
+}
+
 void BleCommunicator::recvCommand()
 {
-    char buf[32] = {0};
-    while(RN4020.available() > 0) {
-        String recv = RN4020.readStringUntil('\n');
+    char buf[64] = {0};
+    StrView_t recv;
+    while(_serial.PollLine(&recv)) {
+	    copyView(&recv, buf, sizeof(buf));
 	    LOG.println("received:");
-	    LOG.println(recv);
+	    LOG.println(buf);
 	    
-	    recv.toCharArray(buf, sizeof(buf));
 	    if(strncmp(buf, "WV,001B,0", 9) == 0) {
 	        if(buf[9] == '1') {
 	            _gainVal = 1;
@@ -174,6 +321,17 @@ void BleCommunicator::recvCommand()
 	            _gainVal = 0;
 	            DEBUG("gain set to 0");
 	        }
+	    } else if(strncmp(buf, "WV,001D,", 8) == 0) {
+	        // rrrrttoo: ref freq, temperament, tonic
+	        uint32_t val = strtoul(&buf[8], NULL, 16);
+	        _tuningVal[0] = (uint16_t)(val >> 16);
+	        _tuningVal[1] = (uint16_t)((val >> 8) & 0xFF);
+	        _tuningVal[2] = (uint16_t)(val & 0xFF);
+	        _tuningUpdated = true;
+	        DEBUG("tuning set to %u,%u,%u", _tuningVal[0], _tuningVal[1], _tuningVal[2]);
+	    } else if(strncmp(buf, "WV,001F,", 8) == 0) {
+	        // applied on next boot
+	        writeMelodyStore(&buf[8]);
 	    }
     }
 }
@@ -181,5 +339,9 @@ void BleCommunicator::recvCommand()
 uint32_t BleCommunicator::Yield()
 {
     recvCommand();
+    DispatchEvents();
+    if(_streamNum != 0 && FREQ_STREAM_DELAY_MS <= millis() - _streamFirst) {
+        sendStream();
+    }
     return 0;
 }
@@ -2,6 +2,14 @@
 #define _BLECOMMUNICATOR_H_
 
 #include "Communicator.h"
+#include "SerialController.h"
+
+// frequency stream characteristic
+#define FREQ_STREAM_SAMPLE_NUM  3   // samples in a notification
+#define FREQ_STREAM_SAMPLE_LEN  6   // freq(LE16), note, cents(LE16), clarity
+#define FREQ_STREAM_PAYLOAD_LEN (1 + FREQ_STREAM_SAMPLE_NUM * FREQ_STREAM_SAMPLE_LEN)
+#define FREQ_STREAM_CMD_LEN     (9 + FREQ_STREAM_PAYLOAD_LEN * 2)  // SHW,hhhh, + hex
+#define FREQ_STREAM_DELAY_MS    150 // a partial batch is sent after this
 
 class BleCommunicator : public Communicator
 {
@@ -11,13 +19,25 @@ public:
     
     virtual uint32_t Initialize();
     virtual uint32_t Yield();
-    virtual void UpdateFreq(uint16_t freq, uint16_t note);
+    virtual void UpdateFreq(uint16_t freq, uint16_t note, uint16_t volume, uint16_t timestamp);
     virtual uint8_t GetGain();
+    virtual void SetBendMode(uint8_t mode);
+    virtual void UpdatePitch(const PitchSample_t* sample);
 
 private:
+    SerialController _serial;
+    bool _streamEnabled;
+    bool _streamFound;          // handle of stream characteristic is known. SUW by uuid otherwise
+    char _streamCmd[FREQ_STREAM_CMD_LEN + 1];
+    uint8_t _streamBuf[FREQ_STREAM_PAYLOAD_LEN];
+    uint8_t _streamNum;
+    uint8_t _streamSeq;
+    uint32_t _streamFirst;      // millis of oldest sample in batch
 
     void recvCommand();
     bool initializeDevice();
+    bool findStreamHandle();
+    void sendStream();
     void purge();
 };
 
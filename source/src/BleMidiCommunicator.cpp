@@ -4,10 +4,12 @@
 #include "Rn4020Controller.h"
 #include "CommonTool.h"
 #include "StringUtility.h"
+#include "MelodyStore.h"
+#include "Rn4020Simulator.h"
 
 #include "debug.h"
 
-#define RN4020  Serial1
+#define RN4020  RN4020_PORT
 
 #define NOTE_BDRM   36
 #define NOTE_SYM    49
@@ -50,21 +52,12 @@
 #define	INST_OBE	68	// Oboe
 #define	INST_PCC	72	// Piccolo
 
+#define MIDI_CC_EXPRESSION  0x0B
+
 #define SYSEX_TEMPLATE	"8080F0437909110A002780F7"
 //#define LYLIC			0x71	// ru
 #define LYLIC			0x6F	// la
 
-typedef struct Note_tag {
-    uint16_t note;
-    uint16_t delay;
-} Note_t;
-
-typedef struct Melody_tag {
-    const uint8_t ch;
-    const Note_t* playNotes;
-    const uint8_t note_len;
-} Melody_t;
-
 static const int8_t kInvalidNote				= INT8_MIN;
 
 // should move these data to BleMidiCommunicator
@@ -104,6 +97,12 @@ const uint16_t kMelBlk1[] = { NOTE_B0b, NOTE_B0b };
 const uint8_t kMelBlk0Count = _countof(kMelBlk0);
 const uint8_t kMelBlk1Count = _countof(kMelBlk1);
 
+// tuning A E A E A
+const uint16_t kMelTun0[] = { NOTE_A0, NOTE_E1, NOTE_A0, NOTE_E1 };
+const uint16_t kMelTun1[] = { NOTE_A0 };
+const uint8_t kMelTun0Count = _countof(kMelTun0);
+const uint8_t kMelTun1Count = _countof(kMelTun1);
+
 /**
  *  boot    C D E F G A B C
  */
@@ -256,6 +255,22 @@ static const Note_t s_blkExecuted[] = {
     { NOTE_C1,  NOTELEN1},
 };
 
+/**
+ * tuning    A E A E A
+ * only play         E A
+ */
+static const Note_t s_tunNotes[] = {
+    { NOTE_E1,  NOTELEN8},
+    { NOTE_A1,  NOTELEN8},
+};
+
+/**
+ * played preset+1 times when tuning is changed
+ */
+static const Note_t s_tunExecuted[] = {
+    { NOTE_A0,  NOTELEN8},
+};
+
 /**
  * melody when tuning is OK
  */
@@ -294,9 +309,11 @@ static const uint8_t kMelodyIdOrc               = 13;
 static const uint8_t kMelodyIdInstChangeOrc     = 14;
 static const uint8_t kMelodyIdHmk               = 15;
 static const uint8_t kMelodyIdInstChangeHmk     = 16;
+static const uint8_t kMelodyIdTun               = 17;
+static const uint8_t kMelodyIdTuningChanged     = 18;
 
 /**
- * Melody table
+ * Melody table. used when data flash has no melody of the id
  */
 static const Melody_t s_melodies[] = {
     { CH_POR, s_fugaNotes,          _countof(s_fugaNotes)       },
@@ -316,17 +333,42 @@ static const Melody_t s_melodies[] = {
     { CH_BRA, s_dovExecuted,        _countof(s_dovExecuted)     },
     { CH_HMK, s_blkNotes,        	_countof(s_blkNotes)     	},
     { CH_HMK, s_blkExecuted,        _countof(s_blkExecuted)     },
+    { CH_VLN, s_tunNotes,           _countof(s_tunNotes)        },
+    { CH_VLN, s_tunExecuted,        _countof(s_tunExecuted)     },
 };
 
+/**
+ *  a write is lost. next note change overwrites its effect
+ */
+static void onBleError(void* context, uint8_t error)
+{
+    DEBUG("ble write error %d", error);
+}
+
 BleMidiCommunicator::BleMidiCommunicator()
 :
-m_ble(new Rn4020Controller(RN4020))
+m_ble(RN4020)
 {
+    m_ble.SetErrorCallback(onBleError, this);
     memset(m_selected, kInvalidNote, sizeof(m_selected));
+    memset(m_velocityScale, VELOCITY_SCALE_ONE, sizeof(m_velocityScale));
     memset(m_channels, 0, sizeof(m_channels));
     _gainVal = 1;
     m_isTuningMode = false;
     m_selected[CH_HMK] = 0;
+    m_playHead = 0;
+    m_playNum = 0;
+    m_playIdx = 0;
+    m_playSounding = false;
+    m_playDue = 0;
+    m_playLead = 0;
+    m_duckedChannels = 0;
+    m_bendMode = kBendOff;
+    m_bend = BEND_CENTER;
+    m_pressure = 0;
+    m_bendSent = 0;
+    m_bendTokens = BEND_BURST_BYTES;
+    m_bendRefilled = 0;
 }
 
 /**
@@ -334,21 +376,25 @@ m_ble(new Rn4020Controller(RN4020))
  */
 BleMidiCommunicator::~BleMidiCommunicator()
 {
-    delete m_ble;
 }
 
 uint32_t BleMidiCommunicator::Initialize()
 {
     DEBUG("%s ENT", __FUNCTION__);
     
-    int counter = 0;
-    while(true) {
-        if(initializeDevice()) {
-            break;
-        }
-        delay(1000);
-    }
+    // connection goes on in Yield()
+    RN4020.begin(115200);
+    m_ble.Initialize();
 	
+    DEBUG("%s EXT", __FUNCTION__);
+    return 0;
+}
+
+/**
+ *  setup instruments each time peer is connected
+ */
+void BleMidiCommunicator::onConnected()
+{
 	programChannel(CH_PNO, INST_PNO);
 	programChannel(CH_POR, INST_POR);
 	programChannel(CH_TRP, INST_TRP);
@@ -365,15 +411,12 @@ uint32_t BleMidiCommunicator::Initialize()
 	
 	setLylic(LYLIC);
 	
-	delay(1900);
-	
+	DelayPlayback(1900);
 	playMelody(kMelodyIdBoot);
-	
-    DEBUG("%s EXT", __FUNCTION__);
-    return 0;
+	Flush();
 }
 
-void BleMidiCommunicator::UpdateFreq(uint16_t freq, uint16_t note)
+void BleMidiCommunicator::UpdateFreq(uint16_t freq, uint16_t note, uint16_t volume, uint16_t timestamp)
 {
     DEBUG("%s ENT", __FUNCTION__);
     
@@ -384,12 +427,16 @@ void BleMidiCommunicator::UpdateFreq(uint16_t freq, uint16_t note)
     
     if(_pitchVal[1] != 0) {
         DEBUG("off before on");
-        userNoteOff(_pitchVal[1]);
+        userNoteOff(_pitchVal[1], timestamp);
     }
     
     if(note != 0) {
         DEBUG("sending on");
-        userNoteOn(note);
+        if(m_bend != BEND_CENTER) {
+            // new note starts in tune
+            userPitchBend(BEND_CENTER, timestamp);
+        }
+        userNoteOn(note, volume, timestamp);
     }
 
     // unused but update just for in case. _pitchVal[1] should be updated in noteOn/Off()
@@ -412,15 +459,15 @@ bool BleMidiCommunicator::IsTuningMode()
 
 uint32_t BleMidiCommunicator::Yield()
 {
-    m_ble->Yield();
+    if(m_ble.Yield() == kRn4020EvtConnected) {
+        onConnected();
+    }
+    DispatchEvents();
+    servicePlayback();
+    Flush();
     return 0;
 }
 
-bool BleMidiCommunicator::initializeDevice()
-{
-    return m_ble->Initialize();
-}
-
 void BleMidiCommunicator::ConfirmaToggleGain()
 {
     playMelody(kMelodyIdFuga);
@@ -442,7 +489,7 @@ void BleMidiCommunicator::ToggleGain()
 
 void BleMidiCommunicator::ConfirmInstChange(uint8_t inst)
 {
-    userNoteOff(_pitchVal[1]);
+    userNoteOff(_pitchVal[1], (uint16_t)millis());
     
     uint8_t melId = 0;
     switch(inst) {
@@ -469,8 +516,13 @@ void BleMidiCommunicator::ChangeInst(uint8_t inst)
 {
     DEBUG("ChangeInst");
 
-    userNoteOff(_pitchVal[1]);
+    userNoteOff(_pitchVal[1], (uint16_t)millis());
+    if(m_bend != BEND_CENTER) {
+        // channels being deselected keep their bend otherwise
+        userPitchBend(BEND_CENTER, (uint16_t)millis());
+    }
     memset(m_selected, kInvalidNote, sizeof(m_selected));
+    memset(m_velocityScale, VELOCITY_SCALE_ONE, sizeof(m_velocityScale));
     
     uint8_t melId = 0;
     switch(inst) {
@@ -490,6 +542,11 @@ void BleMidiCommunicator::ChangeInst(uint8_t inst)
             m_selected[CH_STR] = 4;
             m_selected[CH_OBE] = 7;
             m_selected[CH_PCC] = 12;
+            // strings and brass carry the melody. others are layered under
+            m_velocityScale[CH_TBA] = 96;
+            m_velocityScale[CH_CTR] = 96;
+            m_velocityScale[CH_OBE] = 80;
+            m_velocityScale[CH_PCC] = 64;
             break;
         case kInstPno:
         default:
@@ -510,13 +567,17 @@ void BleMidiCommunicator::ConfirmToggleTuning()
 void BleMidiCommunicator::ToggleTuning()
 {
     DEBUG("ToggleTuning");
-    userNoteOff(_pitchVal[1]);
+    userNoteOff(_pitchVal[1], (uint16_t)millis());
     m_isTuningMode = !m_isTuningMode;
     playMelody(kMelodyIdToggleTuning);
 }
 
 void BleMidiCommunicator::NotifyTune(uint8_t tune)
 {
+    if(m_playNum != 0) {
+        // previous result is still playing. this one would be stale
+        return;
+    }
     switch(tune) {
         case 1:
             playMelody(kMelodyIdGood);
@@ -532,93 +593,324 @@ void BleMidiCommunicator::NotifyTune(uint8_t tune)
     }
 }
 
-void BleMidiCommunicator::userNoteOff(uint16_t note)
+void BleMidiCommunicator::ConfirmTuningChange()
+{
+    userNoteOff(_pitchVal[1], (uint16_t)millis());
+    playMelody(kMelodyIdTun);
+}
+
+void BleMidiCommunicator::ChangeTuning(uint8_t preset)
+{
+    DEBUG("ChangeTuning %d", preset);
+    userNoteOff(_pitchVal[1], (uint16_t)millis());
+    // count of A tells which preset is selected
+    for(uint8_t i = 0; i <= preset; i++) {
+        playMelody(kMelodyIdTuningChanged);
+    }
+}
+
+void BleMidiCommunicator::userNoteOff(uint16_t note, uint16_t timestamp)
 {
     for(int8_t ch = 0; ch < 16; ch++) {
     	if(m_selected[ch] == kInvalidNote) {
     		continue;
     	}
-    	noteOff(ch, note + m_selected[ch]);
+    	noteOff(ch, note + m_selected[ch], timestamp);
     }
 }
 
-void BleMidiCommunicator::userNoteOn(uint16_t note)
+/**
+ *  velocity is taken from the curve, then scaled per channel
+ */
+void BleMidiCommunicator::userNoteOn(uint16_t note, uint16_t volume, uint16_t timestamp)
 {
+    uint8_t velocity = velocityOf(volume);
     for(int8_t ch = 0; ch < 16; ch++) {
     	if(m_selected[ch] == kInvalidNote) {
     		continue;
     	}
-    	noteOn(ch, note + m_selected[ch]);
+    	uint8_t scaled = (uint8_t)constrain((velocity * m_velocityScale[ch]) >> 7, 1, 127);
+    	noteOn(ch, note + m_selected[ch], scaled, timestamp);
     }
 }
 
-void BleMidiCommunicator::noteOff(uint8_t ch, uint16_t note)
+void BleMidiCommunicator::noteOff(uint8_t ch, uint16_t note, uint16_t timestamp)
 {
-    char cmd[10]  = {0};
-    cmd[0] = '8'; cmd[1] = '0'; cmd[2] = '8'; cmd[3] = '0';
-    
-    cmd[4] = '8';
-    itoaUi8(ch, &(cmd[5]));
-    itoaUi16(note, &(cmd[6]));
-    cmd[8] = '7';
-    cmd[9] = 'F';
-    
-    DEBUG(cmd);
-    m_ble->WriteCharacteristic(cmd, 10);
+    sendMessage(0x80 | ch, (uint8_t)note, 0x7F, 2, timestamp);
     m_channels[ch] = 0;
 }
 
-void BleMidiCommunicator::noteOn(uint8_t ch, uint16_t note)
+void BleMidiCommunicator::noteOn(uint8_t ch, uint16_t note, uint8_t velocity, uint16_t timestamp)
 {
-    char cmd[10]  = {0};
-    cmd[0] = '8'; cmd[1] = '0'; cmd[2] = '8'; cmd[3] = '0';
-    
-    cmd[4] = '9';
-    itoaUi8(ch, &(cmd[5]));
-    itoaUi16(note, &(cmd[6]));
-    cmd[8] = '7';
-    cmd[9] = 'F';
-    
-    m_ble->WriteCharacteristic(cmd, 10);
+    sendMessage(0x90 | ch, (uint8_t)note, velocity, 2, timestamp);
     m_channels[ch] = note;
 }
 
+void BleMidiCommunicator::DelayPlayback(uint16_t ms)
+{
+    m_playLead = ms;
+}
+
+bool BleMidiCommunicator::IsPlaying()
+{
+    return m_playNum != 0;
+}
+
+void BleMidiCommunicator::InterruptPlayback(uint8_t mode)
+{
+    switch(mode) {
+        case kPlaybackDuck:
+            duckPlayback(true);
+            break;
+        case kPlaybackCancel:
+            stopPlayback();
+            break;
+        case kPlaybackResume:
+        default:
+            duckPlayback(false);
+            break;
+    }
+}
+
+/**
+ *  queue melody. it's played by servicePlayback()
+ */
 void BleMidiCommunicator::playMelody(uint8_t id)
 {
-    const Melody_t* mel = &(s_melodies[id]);
-    uint8_t ch = mel->ch;
+    if(m_playNum == PLAY_QUEUE_LEN) {
+        DEBUG("melody %d dropped", id);
+        return;
+    }
+    
+    PlayItem_t* item = &m_playQueue[(m_playHead + m_playNum) % PLAY_QUEUE_LEN];
+    item->melody = MelodyStore.Response(id, &(s_melodies[id]));
+    item->lead = m_playLead;
+    m_playLead = 0;
+    if(m_playNum == 0) {
+        m_playIdx = 0;
+        m_playSounding = false;
+        m_playDue = millis() + item->lead;
+    }
+    m_playNum++;
     
-    if(m_channels[ch] != 0) {
-        noteOff(ch, m_channels[ch]);
+    servicePlayback();
+}
+
+/**
+ *  send note on/off of queued melodies whose time has come
+ */
+void BleMidiCommunicator::servicePlayback()
+{
+    uint32_t now = millis();
+    while(m_playNum != 0 && (int32_t)(now - m_playDue) >= 0) {
+        const Melody_t* mel = m_playQueue[m_playHead].melody;
+        uint8_t ch = mel->ch;
+        
+        if(m_playSounding) {
+            noteOff(ch, mel->playNotes[m_playIdx - 1].note, (uint16_t)now);
+            m_playSounding = false;
+        }
+        if(m_playIdx == mel->note_len) {
+            popPlayback(now);
+            continue;
+        }
+        
+        if(m_playIdx == 0 && m_channels[ch] != 0) {
+            noteOff(ch, m_channels[ch], (uint16_t)now);
+        }
+        const Note_t* playNote = &mel->playNotes[m_playIdx++];
+        if(playNote->note != NOTE_NONE) {
+            noteOn(ch, playNote->note, 0x7F, (uint16_t)now);
+            m_playSounding = true;
+        }
+        m_playDue = now + playNote->delay;
+    }
+}
+
+void BleMidiCommunicator::popPlayback(uint32_t now)
+{
+    m_playHead = (m_playHead + 1) % PLAY_QUEUE_LEN;
+    m_playNum--;
+    m_playIdx = 0;
+    m_playSounding = false;
+    if(m_playNum != 0) {
+        m_playDue = now + m_playQueue[m_playHead].lead;
+    } else {
+        duckPlayback(false);
+    }
+}
+
+void BleMidiCommunicator::stopPlayback()
+{
+    if(m_playSounding) {
+        const Melody_t* mel = m_playQueue[m_playHead].melody;
+        noteOff(mel->ch, mel->playNotes[m_playIdx - 1].note, (uint16_t)millis());
+    }
+    m_playNum = 0;
+    m_playIdx = 0;
+    m_playSounding = false;
+    m_playLead = 0;
+    duckPlayback(false);
+}
+
+/**
+ *  lower expression of channels used by queued melodies, or restore ducked ones.
+ *  user selected channels are left as they are
+ */
+void BleMidiCommunicator::duckPlayback(bool duck)
+{
+    if(!duck) {
+        for(uint8_t ch = 0; ch < 16; ch++) {
+            if(m_duckedChannels & (1U << ch)) {
+                controlChange(ch, MIDI_CC_EXPRESSION, 127);
+            }
+        }
+        m_duckedChannels = 0;
+        return;
     }
     
-    for(int i = 0; i < mel->note_len; i++) {
-        const Note_t* playNote = &mel->playNotes[i];
-        if(playNote != NOTE_NONE) {
-            noteOn(ch, playNote->note);
+    for(uint8_t i = 0; i < m_playNum; i++) {
+        uint8_t ch = m_playQueue[(m_playHead + i) % PLAY_QUEUE_LEN].melody->ch;
+        if(m_selected[ch] != kInvalidNote || (m_duckedChannels & (1U << ch))) {
+            continue;
         }
-        delay(playNote->delay);
-        noteOff(ch, playNote->note);
+        controlChange(ch, MIDI_CC_EXPRESSION, PLAY_DUCK_EXPRESSION);
+        m_duckedChannels |= (1U << ch);
     }
 }
 
-void BleMidiCommunicator::programChannel(uint8_t ch, uint8_t inst)
+void BleMidiCommunicator::controlChange(uint8_t ch, uint8_t ctrl, uint8_t val)
+{
+    sendMessage(0xB0 | ch, ctrl, val, 2, (uint16_t)millis());
+}
+
+void BleMidiCommunicator::SetBendMode(uint8_t mode)
 {
-    char cmd[8]  = {0};
-    cmd[0] = '8'; cmd[1] = '0'; cmd[2] = '8'; cmd[3] = '0';
+    m_bendMode = mode;
+}
+
+/**
+ *  stream pitch bend (and pressure) of the held note.
+ *  rate limited, changes below BEND_MIN_DELTA are dropped and bytes are
+ *  taken from a token bucket so that note on/off always find room on the link
+ */
+void BleMidiCommunicator::UpdatePitch(const PitchSample_t* sample)
+{
+    if(m_bendMode == kBendOff || _pitchVal[1] == 0 || !m_ble.IsConnected()) {
+        return;
+    }
+    uint32_t now = millis();
+    if((uint32_t)(now - m_bendSent) < BEND_INTERVAL_MS) {
+        return;
+    }
     
-    cmd[4] = 'C';
-    itoaUi8(ch, &(cmd[5]));
-    itoaUi16(inst, &(cmd[6]));
+    uint16_t bend = bendOf(sample->cents);
+    bool sendBend = (BEND_MIN_DELTA <= labs((int32_t)bend - m_bend));
+    uint8_t pressure = (uint8_t)(sample->volume >> 3);
+    bool sendPressure = (m_bendMode == kBendPitchPressure && PRESSURE_MIN_DELTA <= abs((int16_t)pressure - m_pressure));
+    if(!sendBend && !sendPressure) {
+        return;
+    }
     
-    m_ble->WriteCharacteristic(cmd, 8);
+    uint8_t channelNum = 0;
+    for(uint8_t ch = 0; ch < 16; ch++) {
+        if(m_selected[ch] != kInvalidNote) {
+            channelNum++;
+        }
+    }
+    // timestamp and message for each channel, and a header for each packet they take
+    uint16_t bytes = channelNum * ((sendBend ? 4 : 0) + (sendPressure ? 3 : 0));
+    bytes += (bytes + BLE_MIDI_PACKET_MAX - 2) / (BLE_MIDI_PACKET_MAX - 1);
+    if(!takeBendTokens(bytes, now)) {
+        // try again next frame. the delta is still there
+        return;
+    }
+    m_bendSent = now;
+    
+    if(sendBend) {
+        userPitchBend(bend, sample->timestamp);
+    }
+    if(sendPressure) {
+        userPressure(pressure, sample->timestamp);
+    }
+}
+
+bool BleMidiCommunicator::takeBendTokens(uint16_t bytes, uint32_t now)
+{
+    uint32_t elapsed = now - m_bendRefilled;
+    if(BEND_BURST_BYTES * BEND_MS_PER_BYTE <= elapsed) {
+        m_bendTokens = BEND_BURST_BYTES;
+        m_bendRefilled = now;
+    } else {
+        uint16_t added = elapsed / BEND_MS_PER_BYTE;
+        m_bendTokens = min(m_bendTokens + added, BEND_BURST_BYTES);
+        // remainder is kept for next refill
+        m_bendRefilled += added * BEND_MS_PER_BYTE;
+    }
+    
+    if(m_bendTokens < bytes) {
+        return false;
+    }
+    m_bendTokens -= bytes;
+    return true;
+}
+
+void BleMidiCommunicator::userPitchBend(uint16_t bend, uint16_t timestamp)
+{
+    for(uint8_t ch = 0; ch < 16; ch++) {
+        if(m_selected[ch] == kInvalidNote) {
+            continue;
+        }
+        sendMessage(0xE0 | ch, bend & 0x7F, (bend >> 7) & 0x7F, 2, timestamp);
+    }
+    m_bend = bend;
+}
+
+void BleMidiCommunicator::userPressure(uint8_t pressure, uint16_t timestamp)
+{
+    for(uint8_t ch = 0; ch < 16; ch++) {
+        if(m_selected[ch] == kInvalidNote) {
+            continue;
+        }
+        sendMessage(0xD0 | ch, pressure, 0, 1, timestamp);
+    }
+    m_pressure = pressure;
+}
+
+/**
+ *  buffer a message. packet is written when full or on Flush()
+ *  @param timestamp millis when the event happened, not when it is sent
+ */
+void BleMidiCommunicator::sendMessage(uint8_t status, uint8_t data1, uint8_t data2, uint8_t dataLen, uint16_t timestamp)
+{
+    if(!m_packet.Add(timestamp, status, data1, data2, dataLen)) {
+        Flush();
+        m_packet.Add(timestamp, status, data1, data2, dataLen);
+    }
+}
+
+void BleMidiCommunicator::Flush()
+{
+    if(m_packet.IsEmpty()) {
+        return;
+    }
+    m_ble.WriteCharacteristic(m_packet.Data(), m_packet.Length());
+    m_packet.Clear();
+}
+
+void BleMidiCommunicator::programChannel(uint8_t ch, uint8_t inst)
+{
+    sendMessage(0xC0 | ch, inst, 0, 1, (uint16_t)millis());
 }
 
 void BleMidiCommunicator::setLylic(uint8_t lylic)
 {
+	// sysex is not packed. keep order with buffered messages
+	Flush();
+	
 	char cmd[32] = {0};
-	strncpy(cmd, SYSEX_TEMPLATE, 24);
-	itoaUi16(lylic, &cmd[18]);
+	memcpy(cmd, SYSEX_TEMPLATE, 24);
+	hexUi8(lylic, &cmd[18]);
 	
-	m_ble->WriteCharacteristic(cmd, 24);
+	m_ble.WriteCharacteristic(cmd, 24);
 }
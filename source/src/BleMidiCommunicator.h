@@ -2,8 +2,9 @@
 #define _BLEMIDICOMMUNICATOR_H_
 
 #include "Communicator.h"
-
-class Rn4020Controller;
+#include "Rn4020Controller.h"
+#include "MelodyStore.h"
+#include "BleMidiPacket.h"
 
 #define NOTE_NONE    0
 #define NOTE_C0		60
@@ -42,16 +43,6 @@ class Rn4020Controller;
 #define NOTE_B1		83
 #define NOTE_C2		84
 
-#define kInstTrp    2   // Trumpet
-#define kInstPno    3   // Piano
-#define kInstOrc    4   // Orchestra
-#define kInstHmk    5   // HATSUNE Miku
-
-#define kTuneNone   0
-#define kTuneGood   1
-#define kTuneHigh   2
-#define kTuneLow    3
-
 // should move these data to BleMidiCommunicator
 // fuga G D Bb A G Bb A G F# A D
 extern const uint16_t kMelFuga0[];
@@ -89,6 +80,29 @@ extern const uint16_t kMelBlk1[];
 extern const uint8_t kMelBlk0Count;
 extern const uint8_t kMelBlk1Count;
 
+// tuning A E A E A
+extern const uint16_t kMelTun0[];
+extern const uint16_t kMelTun1[];
+extern const uint8_t kMelTun0Count;
+extern const uint8_t kMelTun1Count;
+
+#define PLAY_QUEUE_LEN      8   // response melodies waiting to be played
+#define PLAY_DUCK_EXPRESSION    40  // CC11 while user is singing
+
+// pitch bend streaming
+#define BEND_INTERVAL_MS        40  // at most 25 updates per second
+#define BEND_MIN_DELTA          64  // about 1.5 cents. smaller changes are not sent
+#define BEND_MS_PER_BYTE        2   // streaming budget of 500 bytes per second
+#define BEND_BURST_BYTES        48
+
+// velocity
+#define VELOCITY_SCALE_ONE      128 // per channel scale in Q7
+
+typedef struct PlayItem_tag {
+    const Melody_t* melody;
+    uint16_t lead;          // silence before the melody in ms
+} PlayItem_t;
+
 class BleMidiCommunicator : public Communicator
 {
 public:
@@ -97,7 +111,7 @@ public:
     
     virtual uint32_t Initialize();
     virtual uint32_t Yield();
-    virtual void UpdateFreq(uint16_t freq, uint16_t note);
+    virtual void UpdateFreq(uint16_t freq, uint16_t note, uint16_t volume, uint16_t timestamp);
     virtual uint8_t GetGain();
     virtual bool IsTuningMode();
     virtual void ConfirmaToggleGain();
@@ -107,20 +121,53 @@ public:
     virtual void ConfirmToggleTuning();
     virtual void ToggleTuning();
     virtual void NotifyTune(uint8_t tune);
+    virtual void ConfirmTuningChange();
+    virtual void ChangeTuning(uint8_t preset);
+    virtual void DelayPlayback(uint16_t ms);
+    virtual bool IsPlaying();
+    virtual void InterruptPlayback(uint8_t mode);
+    virtual void Flush();
+    virtual void SetBendMode(uint8_t mode);
+    virtual void UpdatePitch(const PitchSample_t* sample);
     
 private:
-    char m_noteCmdBuf[32];
+    BleMidiPacket m_packet;     // messages waiting for Flush()
     int8_t m_selected[16];        // user selected channels and note to play
+    uint8_t m_velocityScale[16];    // of user channels in Q7
     uint8_t m_channels[16]; // curretn midi note of channel
-    Rn4020Controller* m_ble;
+    Rn4020Controller m_ble;
     bool m_isTuningMode;
+    // melodies are played from Yield() not to block pitch detection
+    PlayItem_t m_playQueue[PLAY_QUEUE_LEN];
+    uint8_t m_playHead;
+    uint8_t m_playNum;
+    uint8_t m_playIdx;          // next note of head melody
+    bool m_playSounding;        // previous note of head melody is on
+    uint32_t m_playDue;         // millis of next event
+    uint16_t m_playLead;        // lead of next queued melody
+    uint16_t m_duckedChannels;  // bit per channel
+    uint8_t m_bendMode;
+    uint16_t m_bend;            // last sent to user channels
+    uint8_t m_pressure;
+    uint32_t m_bendSent;        // millis of last streamed update
+    uint16_t m_bendTokens;      // bytes allowed to stream now
+    uint32_t m_bendRefilled;
     
-    bool initializeDevice();
-    void userNoteOff(uint16_t note);
-    void userNoteOn(uint16_t note);
-    void noteOff(uint8_t ch, uint16_t note);
-    void noteOn(uint8_t ch, uint16_t note);
+    void onConnected();
+    void userNoteOff(uint16_t note, uint16_t timestamp);
+    void userNoteOn(uint16_t note, uint16_t volume, uint16_t timestamp);
+    void noteOff(uint8_t ch, uint16_t note, uint16_t timestamp);
+    void noteOn(uint8_t ch, uint16_t note, uint8_t velocity, uint16_t timestamp);
     void playMelody(uint8_t id);
+    void servicePlayback();
+    void popPlayback(uint32_t now);
+    void stopPlayback();
+    void duckPlayback(bool duck);
+    void controlChange(uint8_t ch, uint8_t ctrl, uint8_t val);
+    void userPitchBend(uint16_t bend, uint16_t timestamp);
+    void userPressure(uint8_t pressure, uint16_t timestamp);
+    bool takeBendTokens(uint16_t bytes, uint32_t now);
+    void sendMessage(uint8_t status, uint8_t data1, uint8_t data2, uint8_t dataLen, uint16_t timestamp);
     void programChannel(uint8_t ch, uint8_t inst);
     void setLylic(uint8_t lylic);
 };
@@ -0,0 +1,50 @@
+#include "BleMidiPacket.h"
+
+BleMidiPacket::BleMidiPacket()
+{
+    Clear();
+}
+
+bool BleMidiPacket::Add(uint16_t timestamp, uint8_t status, uint8_t data1, uint8_t data2, uint8_t dataLen)
+{
+    timestamp &= BLE_MIDI_TIMESTAMP_MASK;
+    if(_len != 0) {
+        // receivers take a smaller low byte as a wrap, so time must not go back
+        uint16_t delta = (timestamp - _lastTimestamp) & BLE_MIDI_TIMESTAMP_MASK;
+        if(BLE_MIDI_TIMESTAMP_MASK / 2 < delta) {
+            timestamp = _lastTimestamp;
+        } else if(0x80 <= delta) {
+            // more than one wrap can't be told from the low byte
+            return false;
+        }
+    }
+    uint8_t tsLow = 0x80 | (timestamp & 0x7F);
+    bool running = (_len != 0 && status == _runningStatus && timestamp == _lastTimestamp);
+    
+    uint8_t need = dataLen + (running ? 0 : 2) + (_len == 0 ? 1 : 0);
+    if(BLE_MIDI_PACKET_MAX < _len + need) {
+        return false;
+    }
+    
+    if(_len == 0) {
+        _buf[_len++] = 0x80 | ((timestamp >> 7) & 0x3F);
+    }
+    if(!running) {
+        _buf[_len++] = tsLow;
+        _buf[_len++] = status;
+        _runningStatus = status;
+        _lastTimestamp = timestamp;
+    }
+    _buf[_len++] = data1;
+    if(dataLen == 2) {
+        _buf[_len++] = data2;
+    }
+    return true;
+}
+
+void BleMidiPacket::Clear()
+{
+    _len = 0;
+    _runningStatus = 0;
+    _lastTimestamp = 0;
+}
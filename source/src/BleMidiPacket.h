@@ -0,0 +1,39 @@
+#ifndef _BLEMIDIPACKET_H_
+#define _BLEMIDIPACKET_H_
+
+#include <inttypes.h>
+
+#define BLE_MIDI_PACKET_MAX     20  // characteristic size of RN4020
+#define BLE_MIDI_TIMESTAMP_MASK 0x1FFF  // 13 bits of milliseconds
+
+/**
+ *  packs midi messages into one BLE-MIDI packet.
+ *  header, then timestamp and message for each. status and timestamp are
+ *  omitted for running status within the same millisecond.
+ *  a timestamp older than the previous message is sent as the previous one.
+ */
+class BleMidiPacket
+{
+public:
+    BleMidiPacket();
+    
+    /**
+     *  @param timestamp millis of the event. only low 13 bits are used
+     *  @param dataLen 1 or 2
+     *  @return false if packet has no room or timestamp is too far from
+     *          the previous message. nothing is added
+     */
+    bool Add(uint16_t timestamp, uint8_t status, uint8_t data1, uint8_t data2, uint8_t dataLen);
+    void Clear();
+    bool IsEmpty() { return _len == 0; }
+    const uint8_t* Data() { return _buf; }
+    uint8_t Length() { return _len; }
+    
+private:
+    uint8_t _buf[BLE_MIDI_PACKET_MAX];
+    uint8_t _len;
+    uint8_t _runningStatus;
+    uint16_t _lastTimestamp;    // 13 bits
+};
+
+#endif //_BLEMIDIPACKET_H_
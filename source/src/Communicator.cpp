@@ -1,10 +1,31 @@
 #include "Communicator.h"
 #include <Arduino.h>
 
+// velocity by volume >> VELOCITY_LUT_SHIFT
+static const uint8_t kVelocityLuts[kVelocityCurveNum][1024 >> VELOCITY_LUT_SHIFT] = {
+    // linear
+    {   1,   4,   8,  12,  16,  20,  25,  29,  33,  37,  41,  45,  49,  53,  57,  61,
+       66,  70,  74,  78,  82,  86,  90,  94,  98, 102, 107, 111, 115, 119, 123, 127 },
+    // soft. square root
+    {   1,  23,  32,  40,  46,  51,  56,  60,  65,  68,  72,  76,  79,  82,  85,  88,
+       91,  94,  97,  99, 102, 105, 107, 109, 112, 114, 116, 119, 121, 123, 125, 127 },
+    // hard. square
+    {   1,   1,   1,   1,   2,   3,   5,   6,   8,  11,  13,  16,  19,  22,  26,  30,
+       34,  38,  43,  48,  53,  58,  64,  70,  76,  83,  89,  96, 104, 111, 119, 127 },
+};
+
 Communicator::Communicator()
 {
     memset(_pitchVal, 0, sizeof(_pitchVal));
     _gainVal = 0;
+    memset(_tuningVal, 0, sizeof(_tuningVal));
+    _tuningUpdated = false;
+    _velocityLut = kVelocityLuts[kVelocityLinear];
+    _evtHead = 0;
+    _evtTail = 0;
+    _evtMaxDepth = 0;
+    _evtDropped = 0;
+    _evtCoalesced = 0;
 }
 
 Communicator::~Communicator()
@@ -21,7 +42,7 @@ uint32_t Communicator::Yield()
     return 0;
 }
 
-void Communicator::UpdateFreq(uint16_t freq, uint16_t note)
+void Communicator::UpdateFreq(uint16_t freq, uint16_t note, uint16_t volume, uint16_t timestamp)
 {
 }
 
@@ -63,4 +84,194 @@ void Communicator::NotifyTune(uint8_t tune)
 {
 }
 
+void Communicator::ConfirmTuningChange()
+{
+}
+
+void Communicator::ChangeTuning(uint8_t preset)
+{
+}
+
+/**
+ *  returns true only once for each tuning request from remote
+ */
+bool Communicator::FetchTuning(uint16_t* refFreq, uint8_t* temperament, uint8_t* tonic)
+{
+    if(!_tuningUpdated) {
+        return false;
+    }
+    *refFreq = _tuningVal[0];
+    *temperament = (uint8_t)_tuningVal[1];
+    *tonic = (uint8_t)_tuningVal[2];
+    _tuningUpdated = false;
+    return true;
+}
+
+/**
+ *  silence before next response melody
+ */
+void Communicator::DelayPlayback(uint16_t ms)
+{
+}
+
+bool Communicator::IsPlaying()
+{
+    return false;
+}
+
+void Communicator::InterruptPlayback(uint8_t mode)
+{
+}
+
+/**
+ *  send messages buffered so far
+ */
+void Communicator::Flush()
+{
+}
+
+void Communicator::SetBendMode(uint8_t mode)
+{
+}
+
+void Communicator::SetVelocityCurve(uint8_t curve)
+{
+    if(kVelocityCurveNum <= curve) {
+        return;
+    }
+    _velocityLut = kVelocityLuts[curve];
+}
+
+/**
+ *  note on velocity by curve set with SetVelocityCurve()
+ */
+uint8_t Communicator::velocityOf(uint16_t volume)
+{
+    return _velocityLut[min(volume, (uint16_t)1023) >> VELOCITY_LUT_SHIFT];
+}
 
+/**
+ *  14 bit pitch bend for deviation in 1/16 cent
+ */
+uint16_t Communicator::bendOf(int16_t cents)
+{
+    int32_t bend = BEND_CENTER + (int32_t)cents * BEND_CENTER / (BEND_RANGE_CENTS << 4);
+    return (uint16_t)constrain(bend, 0, 0x3FFF);
+}
+
+/**
+ *  called every frame while a note is held
+ */
+void Communicator::UpdatePitch(const PitchSample_t* sample)
+{
+}
+
+void Communicator::PostNote(uint16_t freq, uint16_t note, uint16_t volume, uint16_t timestamp)
+{
+    CommEvent_t* evt = reserveEvent();
+    if(evt == NULL) {
+        return;
+    }
+    evt->type = kCommEvtNote;
+    evt->u.note.freq = freq;
+    evt->u.note.note = note;
+    evt->u.note.volume = volume;
+    evt->u.note.timestamp = timestamp;
+    publishEvent();
+}
+
+void Communicator::PostTune(uint8_t tune)
+{
+    CommEvent_t* evt = reserveEvent();
+    if(evt == NULL) {
+        return;
+    }
+    evt->type = kCommEvtTune;
+    evt->u.tune = tune;
+    publishEvent();
+}
+
+void Communicator::PostPitch(const PitchSample_t* sample)
+{
+    CommEvent_t* evt = reserveEvent();
+    if(evt == NULL) {
+        return;
+    }
+    evt->type = kCommEvtPitch;
+    evt->u.pitch = *sample;
+    publishEvent();
+}
+
+void Communicator::GetQueueStats(CommQueueStats_t* stats)
+{
+    stats->depth = (_evtHead - _evtTail) & (COMM_EVENT_QUEUE_LEN - 1);
+    stats->maxDepth = _evtMaxDepth;
+    stats->dropped = _evtDropped;
+    stats->coalesced = _evtCoalesced;
+}
+
+/**
+ *  @return slot to fill then publishEvent(). NULL if queue is full
+ */
+CommEvent_t* Communicator::reserveEvent()
+{
+    uint8_t next = (_evtHead + 1) & (COMM_EVENT_QUEUE_LEN - 1);
+    if(next == _evtTail) {
+        _evtDropped++;
+        return NULL;
+    }
+    return &_events[_evtHead];
+}
+
+/**
+ *  make reserved slot visible to consumer. head is written after the slot
+ */
+void Communicator::publishEvent()
+{
+    uint8_t head = (_evtHead + 1) & (COMM_EVENT_QUEUE_LEN - 1);
+    _evtHead = head;
+    uint8_t depth = (head - _evtTail) & (COMM_EVENT_QUEUE_LEN - 1);
+    if(_evtMaxDepth < depth) {
+        _evtMaxDepth = depth;
+    }
+}
+
+/**
+ *  dispatch events posted so far. called from Yield(), or before a direct
+ *  call that must see the posted note
+ */
+void Communicator::DispatchEvents()
+{
+    uint8_t head = _evtHead;
+    uint8_t tail = _evtTail;
+    while(tail != head) {
+        const CommEvent_t* evt = &_events[tail];
+        if(isSuperseded(tail, head)) {
+            _evtCoalesced++;
+        } else if(evt->type == kCommEvtNote) {
+            UpdateFreq(evt->u.note.freq, evt->u.note.note, evt->u.note.volume, evt->u.note.timestamp);
+        } else if(evt->type == kCommEvtTune) {
+            NotifyTune(evt->u.tune);
+        } else if(evt->type == kCommEvtPitch) {
+            UpdatePitch(&evt->u.pitch);
+        }
+        tail = (tail + 1) & (COMM_EVENT_QUEUE_LEN - 1);
+        _evtTail = tail;
+    }
+}
+
+/**
+ *  a later note makes earlier notes and pitches stale. e.g. note on then
+ *  note off collapses to the off. only the latest tune verdict counts
+ */
+bool Communicator::isSuperseded(uint8_t idx, uint8_t head)
+{
+    uint8_t type = _events[idx].type;
+    for(uint8_t i = (idx + 1) & (COMM_EVENT_QUEUE_LEN - 1); i != head; i = (i + 1) & (COMM_EVENT_QUEUE_LEN - 1)) {
+        uint8_t later = _events[i].type;
+        if(later == type || (type == kCommEvtPitch && later == kCommEvtNote)) {
+            return true;
+        }
+    }
+    return false;
+}
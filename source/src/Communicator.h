@@ -3,6 +3,77 @@
 
 #include <inttypes.h>
 
+// instrument for ChangeInst()
+#define kInstTrp    2   // Trumpet
+#define kInstPno    3   // Piano
+#define kInstOrc    4   // Orchestra
+#define kInstHmk    5   // HATSUNE Miku
+
+// verdict for NotifyTune()
+#define kTuneNone   0
+#define kTuneGood   1
+#define kTuneHigh   2
+#define kTuneLow    3
+
+// what happens to response melody when user starts singing
+#define kPlaybackResume     0   // user stopped. restore ducked melody
+#define kPlaybackDuck       1   // keep playing with lower expression
+#define kPlaybackCancel     2   // stop and discard queued melodies
+
+// what is streamed for the held note between edges
+#define kBendOff            0   // note on/off only
+#define kBendPitch          1   // pitch bend
+#define kBendPitchPressure  2   // pitch bend and channel pressure from volume
+#define BEND_CENTER         0x2000
+#define BEND_RANGE_CENTS    200 // receiver default of +-2 semitones
+#define PRESSURE_MIN_DELTA  4   // smaller channel pressure changes are not sent by any transport
+
+// note on velocity from volume
+#define kVelocityLinear     0
+#define kVelocitySoft       1   // quiet voice still sounds
+#define kVelocityHard       2   // needs a strong voice for full velocity
+#define kVelocityCurveNum   3
+#define VELOCITY_LUT_SHIFT  5   // volume 0-1023 to 32 entries
+
+/**
+ *  one frame of the held note
+ */
+typedef struct PitchSample_tag {
+    int16_t cents;      // from held note in 1/16 cent
+    uint16_t volume;    // 0-1023
+    uint16_t timestamp; // capture time in millis
+    uint16_t freq;      // detected in this frame
+    uint8_t note;       // held note
+    int16_t clarity;    // nsdf height. 1 << 14 for perfectly periodic
+} PitchSample_t;
+
+// events posted by detection loop and dispatched in Yield()
+#define COMM_EVENT_QUEUE_LEN    8   // power of 2
+#define kCommEvtNote        1   // UpdateFreq
+#define kCommEvtTune        2   // NotifyTune
+#define kCommEvtPitch       3   // UpdatePitch
+
+typedef struct CommEvent_tag {
+    uint8_t type;
+    union {
+        struct {
+            uint16_t freq;
+            uint16_t note;
+            uint16_t volume;
+            uint16_t timestamp;
+        } note;
+        uint8_t tune;
+        PitchSample_t pitch;
+    } u;
+} CommEvent_t;
+
+typedef struct CommQueueStats_tag {
+    uint8_t depth;          // events waiting now
+    uint8_t maxDepth;
+    uint16_t dropped;       // posted to full queue
+    uint16_t coalesced;     // superseded by a later event before dispatch
+} CommQueueStats_t;
+
 class Communicator
 {
 public:
@@ -11,7 +82,7 @@ public:
     
     virtual uint32_t Initialize();
     virtual uint32_t Yield();
-    virtual void UpdateFreq(uint16_t freq, uint16_t note);
+    virtual void UpdateFreq(uint16_t freq, uint16_t note, uint16_t volume, uint16_t timestamp);
     virtual uint8_t GetGain();
     virtual bool IsTuningMode();
     virtual void ConfirmaToggleGain();
@@ -21,10 +92,47 @@ public:
     virtual void ConfirmToggleTuning();
     virtual void ToggleTuning();
     virtual void NotifyTune(uint8_t tune);
+    virtual void ConfirmTuningChange();
+    virtual void ChangeTuning(uint8_t preset);
+    virtual bool FetchTuning(uint16_t* refFreq, uint8_t* temperament, uint8_t* tonic);
+    virtual void DelayPlayback(uint16_t ms);
+    virtual bool IsPlaying();
+    virtual void InterruptPlayback(uint8_t mode);
+    virtual void Flush();
+    virtual void SetBendMode(uint8_t mode);
+    virtual void SetVelocityCurve(uint8_t curve);
+    virtual void UpdatePitch(const PitchSample_t* sample);
+    
+    // queued versions. safe to call while transport is busy
+    void PostNote(uint16_t freq, uint16_t note, uint16_t volume, uint16_t timestamp);
+    void PostTune(uint8_t tune);
+    void PostPitch(const PitchSample_t* sample);
+    void GetQueueStats(CommQueueStats_t* stats);
+    void DispatchEvents();
     
 protected:
     uint16_t _pitchVal[2];
     uint8_t _gainVal;
+    uint16_t _tuningVal[3];     // ref freq, temperament, tonic requested by remote
+    bool _tuningUpdated;
+    const uint8_t* _velocityLut;
+    
+    uint8_t velocityOf(uint16_t volume);
+    static uint16_t bendOf(int16_t cents);
+    
+private:
+    // single producer(Post*) and single consumer(dispatchEvents).
+    // each index is written by one side only
+    CommEvent_t _events[COMM_EVENT_QUEUE_LEN];
+    volatile uint8_t _evtHead;
+    volatile uint8_t _evtTail;
+    uint8_t _evtMaxDepth;
+    uint16_t _evtDropped;
+    uint16_t _evtCoalesced;
+    
+    CommEvent_t* reserveEvent();
+    void publishEvent();
+    bool isSuperseded(uint8_t idx, uint8_t head);
 };
 
 #endif //_COMMUNICATOR_H_
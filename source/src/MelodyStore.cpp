@@ -0,0 +1,191 @@
+#include "MelodyStore.h"
+#include <Arduino.h>
+#include "data_flash_util.h"
+
+#include "debug.h"
+
+#define STORE_ADDRESS       (MELODY_STORE_BLOCK * PFDL_DATA_FLASH_BLOCK_SIZE)
+#define STORE_MAGIC0        'M'
+#define STORE_MAGIC1        'S'
+#define STORE_VERSION       1
+#define STORE_HEADER_LEN    10
+#define READ_CHUNK          32
+#define MIDI_CH_NUM         16
+#define MELODY0_MIN         2       // an interval at least. shorter melody0 fires on any note
+
+MelodyStoreClass MelodyStore;
+
+/**
+ *  sequential reader of data flash. reads in chunks and sums crc of read bytes
+ */
+typedef struct StoreReader_tag {
+    uint16_t addr;
+    uint16_t end;
+    uint16_t crc;
+    bool error;
+    uint8_t pos;
+    uint8_t len;
+    uint8_t buf[READ_CHUNK];
+} StoreReader_t;
+
+static uint16_t UpdateCrc16(uint16_t crc, uint8_t data)
+{
+    // crc16-ccitt
+    crc ^= (uint16_t)data << 8;
+    for(uint8_t i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    return crc;
+}
+
+static void OpenReader(StoreReader_t* r, uint16_t addr, uint16_t len)
+{
+    r->addr = addr;
+    r->end = addr + len;
+    r->crc = 0xFFFF;
+    r->error = false;
+    r->pos = 0;
+    r->len = 0;
+}
+
+static uint8_t ReadByte(StoreReader_t* r)
+{
+    if(r->pos == r->len) {
+        uint16_t rest = r->end - r->addr;
+        r->len = (READ_CHUNK < rest) ? READ_CHUNK : (uint8_t)rest;
+        r->pos = 0;
+        if(r->len == 0 || pfdl_read(r->addr, r->buf, r->len) != PFDL_OK) {
+            r->error = true;
+            r->len = 0;
+            return 0;
+        }
+        r->addr += r->len;
+    }
+    uint8_t data = r->buf[r->pos++];
+    r->crc = UpdateCrc16(r->crc, data);
+    return data;
+}
+
+MelodyStoreClass::MelodyStoreClass()
+:
+_commandNum(0),
+_responseNum(0)
+{
+}
+
+bool MelodyStoreClass::Load()
+{
+    _commandNum = 0;
+    _responseNum = 0;
+    if(pfdl_open() != PFDL_OK) {
+        pfdl_close();
+        return false;
+    }
+
+    StoreReader_t r;
+    uint8_t header[STORE_HEADER_LEN];
+    OpenReader(&r, STORE_ADDRESS, STORE_HEADER_LEN);
+    for(uint8_t i = 0; i < STORE_HEADER_LEN; i++) {
+        header[i] = ReadByte(&r);
+    }
+    uint8_t commandNum = header[3];
+    uint8_t responseNum = header[4];
+    uint16_t bodyLen = header[6] | ((uint16_t)header[7] << 8);
+    uint16_t crc = header[8] | ((uint16_t)header[9] << 8);
+    if(r.error || header[0] != STORE_MAGIC0 || header[1] != STORE_MAGIC1 || header[2] != STORE_VERSION
+        || MELODY_COMMAND_MAX < commandNum || MELODY_STORE_RESPONSE_MAX < responseNum
+        || MELODY_STORE_SIZE - STORE_HEADER_LEN < bodyLen) {
+        pfdl_close();
+        DEBUG("no melody store");
+        return false;
+    }
+
+    // tables are filled directly. counts are set only when crc matches
+    // and every field is in range, as a matching crc doesn't prove the writer right
+    OpenReader(&r, STORE_ADDRESS + STORE_HEADER_LEN, bodyLen);
+    uint8_t noteNum = 0;
+    for(uint8_t i = 0; i < commandNum && !r.error; i++) {
+        uint8_t len0 = ReadByte(&r);
+        uint8_t len1 = ReadByte(&r);
+        if(len0 < MELODY0_MIN || MAX_MELODY_LENGTH < len0 || MAX_MELODY_LENGTH < len1
+            || MELODY_STORE_COMMAND_NOTES < noteNum + len0 + len1) {
+            r.error = true;
+            break;
+        }
+        MelodyCommand_t* cmd = &_commands[i];
+        cmd->melody0 = &_commandNotes[noteNum];
+        cmd->melody0_len = len0;
+        cmd->melody1 = &_commandNotes[noteNum + len0];
+        cmd->melody1_len = len1;
+        for(uint8_t j = 0; j < len0 + len1; j++) {
+            uint8_t note = ReadByte(&r);
+            if(MELODY_NOTE_NUM <= note) {
+                r.error = true;
+            }
+            _commandNotes[noteNum++] = note;
+        }
+    }
+
+    noteNum = 0;
+    for(uint8_t i = 0; i < responseNum && !r.error; i++) {
+        Melody_t* mel = &_responses[i];
+        mel->ch = ReadByte(&r);
+        mel->note_len = ReadByte(&r);
+        if(MIDI_CH_NUM <= mel->ch || MELODY_STORE_RESPONSE_NOTES < noteNum + mel->note_len) {
+            r.error = true;
+            break;
+        }
+        mel->playNotes = &_responseNotes[noteNum];
+        for(uint8_t j = 0; j < mel->note_len; j++) {
+            Note_t* note = &_responseNotes[noteNum++];
+            note->note = ReadByte(&r);
+            if(MELODY_NOTE_NUM <= note->note) {
+                r.error = true;
+            }
+            note->delay = ReadByte(&r);
+            note->delay |= (uint16_t)ReadByte(&r) << 8;
+        }
+    }
+    pfdl_close();
+
+    if(r.error || r.crc != crc) {
+        DEBUG("melody store broken");
+        return false;
+    }
+    _commandNum = commandNum;
+    _responseNum = responseNum;
+    DEBUG("melody store %d commands, %d responses", _commandNum, _responseNum);
+    return true;
+}
+
+bool MelodyStoreClass::Write(uint16_t offset, const uint8_t* data, uint8_t len)
+{
+    if(MELODY_STORE_SIZE < offset + len) {
+        return false;
+    }
+
+    pfdl_status_t result = pfdl_open();
+    if(result == PFDL_OK && offset == 0) {
+        result = pfdl_erase_block(MELODY_STORE_BLOCK);
+    }
+    if(result == PFDL_OK) {
+        result = pfdl_write(STORE_ADDRESS + offset, const_cast<uint8_t*>(data), len);
+    }
+    pfdl_close();
+    return result == PFDL_OK;
+}
+
+void MelodyStoreClass::OverrideCommands(MelodyCommand_t* commands, uint8_t num)
+{
+    for(uint8_t i = 0; i < num && i < _commandNum; i++) {
+        commands[i] = _commands[i];
+    }
+}
+
+const Melody_t* MelodyStoreClass::Response(uint8_t id, const Melody_t* fallback)
+{
+    if(id < _responseNum) {
+        return &_responses[id];
+    }
+    return fallback;
+}
@@ -0,0 +1,68 @@
+#ifndef _MELODYSTORE_H_
+#define _MELODYSTORE_H_
+
+#include <inttypes.h>
+#include "MelodyCommandReceiver.h"
+
+#define MELODY_STORE_BLOCK          7       // data flash block 0x1C00-0x1FFF
+#define MELODY_STORE_SIZE           1024
+#define MELODY_STORE_RESPONSE_MAX   24
+#define MELODY_STORE_COMMAND_NOTES  64      // notes of all command melodies
+#define MELODY_STORE_RESPONSE_NOTES 96      // notes of all response melodies
+
+typedef struct Note_tag {
+    uint16_t note;
+    uint16_t delay;
+} Note_t;
+
+typedef struct Melody_tag {
+    uint8_t ch;
+    const Note_t* playNotes;
+    uint8_t note_len;
+} Melody_t;
+
+/**
+ *  command and response melodies in data flash.
+ *
+ *  header(10 bytes)
+ *    'M' 'S', version, command num, response num, 0, body length(LE16), crc16 of body(LE16)
+ *  body
+ *    command:  melody0 length, melody1 length, notes
+ *    response: midi ch, note num, {note, delay ms(LE16)} x note num
+ *
+ *  entries missing in flash fall back to compiled ones.
+ *  melody0 has 2 notes or more, notes are below 128 and ch below 16.
+ *  otherwise whole store is rejected.
+ *
+ *  only BleCommunicator writes the store(WV,001F from the phone).
+ *  BleMidiCommunicator is a central without a writable characteristic,
+ *  so a store for it is written by a BleCommunicator build beforehand.
+ */
+class MelodyStoreClass
+{
+public:
+    MelodyStoreClass();
+    /**
+     *  read whole store once. false if flash is blank or broken
+     */
+    bool Load();
+    /**
+     *  write a part of store image. offset 0 erases the block first.
+     *  written image is used from next Load()
+     */
+    bool Write(uint16_t offset, const uint8_t* data, uint8_t len);
+    void OverrideCommands(MelodyCommand_t* commands, uint8_t num);
+    const Melody_t* Response(uint8_t id, const Melody_t* fallback);
+
+private:
+    uint8_t _commandNum;
+    uint8_t _responseNum;
+    MelodyCommand_t _commands[MELODY_COMMAND_MAX];
+    Melody_t _responses[MELODY_STORE_RESPONSE_MAX];
+    uint16_t _commandNotes[MELODY_STORE_COMMAND_NOTES];
+    Note_t _responseNotes[MELODY_STORE_RESPONSE_NOTES];
+};
+
+extern MelodyStoreClass MelodyStore;
+
+#endif //_MELODYSTORE_H_
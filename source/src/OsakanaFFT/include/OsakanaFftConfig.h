@@ -9,8 +9,11 @@
 
 #if 1 // N=256, fixed Q1.14 fixed point
 #define _USE_Q1_14_FIXEDPOINT
+#define USE_BIT_REVERSE_N128	// smaller plan for high pitch
+#define USE_TWIDDLE_TABLE_N128
 #define USE_BIT_REVERSE_N256
 #define USE_TWIDDLE_TABLE_N256
+#define OSAKANA_FP_FFT_CONTEXT_NUM	2	// N128 and N256 plans
 #endif
 
 #if 0 // N=256, fixed Q15.16 fixed point
@@ -38,6 +38,38 @@ struct _OsakanaFpFftContext_t {
 
 };
 
+#if defined(USE_HARDCORD_TABLE)
+#if !defined(OSAKANA_FP_FFT_CONTEXT_NUM)
+#define OSAKANA_FP_FFT_CONTEXT_NUM	1
+#endif
+// contexts only point to const tables. they are taken from static pool
+static OsakanaFpFftContext_t s_contextPool[OSAKANA_FP_FFT_CONTEXT_NUM];
+static bool s_contextUsed[OSAKANA_FP_FFT_CONTEXT_NUM];
+
+static OsakanaFpFftContext_t* allocContext()
+{
+	for (int i = 0; i < OSAKANA_FP_FFT_CONTEXT_NUM; i++) {
+		if (!s_contextUsed[i]) {
+			s_contextUsed[i] = true;
+			return &s_contextPool[i];
+		}
+	}
+	return NULL;
+}
+
+static void freeContext(OsakanaFpFftContext_t* ctx)
+{
+	for (int i = 0; i < OSAKANA_FP_FFT_CONTEXT_NUM; i++) {
+		if (ctx == &s_contextPool[i]) {
+			s_contextUsed[i] = false;
+		}
+	}
+}
+#else
+#define allocContext()		(OsakanaFpFftContext_t*)malloc(sizeof(OsakanaFpFftContext_t))
+#define freeContext(ctx)	free(ctx)
+#endif
+
 // W^n_N = exp(-i2pin/N)
 // = cos(2 pi n/N) - isin(2 pi n/N)
 static inline osk_fp_complex_t twiddle(int n, int Nin)
@@ -53,7 +85,7 @@ static inline osk_fp_complex_t twiddle(int n, int Nin)
 int InitOsakanaFpFft(OsakanaFpFftContext_t** pctx, int N, int log2N)
 {
 	int ret = 0;
-	OsakanaFpFftContext_t* ctx = (OsakanaFpFftContext_t*)malloc(sizeof(OsakanaFpFftContext_t));
+	OsakanaFpFftContext_t* ctx = allocContext();
 	if (ctx == NULL) {
 		return -1;
 	}
@@ -112,7 +144,7 @@ void CleanOsakanaFpFft(OsakanaFpFftContext_t* ctx)
 	ctx->twiddles = NULL;
 	ctx->bitReverseIndexTable = NULL;
 
-	free(ctx);
+	freeContext(ctx);
 }
 
 static inline void fp_butterfly(osk_fp_complex_t* r, const osk_fp_complex_t* tf, int idx_a, int idx_b)
@@ -2,31 +2,113 @@
 #define _EDGEDETECTOR_H_
 
 #include <stdint.h>
+#include "OsakanaFp.h"
+#include "ContinuityDetector.h"
+#include "VolumeComparator.h"
+#include "OnsetDetector.h"
 
-#define HISTROY_LEN	3
-
-class ContinuityDetector;
-class VolumeComparator;
+// volume rise regarded as attack
+#define ONSET_MIN_RISE		128
+// nsdf height required to notify a note on its first frame
+#define PREDICT_CLARITY_TH	FLOAT2FP(0.9f)
 
+/**
+ *	HistoryLen:	frames voted for a note
+ *	Agreement:	frames out of HistoryLen that must agree. HistoryLen for strict continuity
+ *	OnVolume, OffVolume: volume hysteresis. notes below it are regarded as 0
+ */
+template <uint8_t HistoryLen = 3, uint8_t Agreement = HistoryLen, uint16_t OnVolume = 256, uint16_t OffVolume = 128>
 class EdgeDetector
 {
 public:
-	EdgeDetector();
-	~EdgeDetector();
+	EdgeDetector()
+		:
+		_lastNotifiedVal(0),
+		_edgeTime(0),
+		_predict(false),
+		_vc(OnVolume, OffVolume),
+		_od(ONSET_MIN_RISE)
+	{
+	}
+
 	/**
 	 *	detect note change.
 	 *	@return	true when edge(value change) detected
 	 *	@note	given value culd different from current note.
 	 *			so use CurrentNote() to get latest internal value.
+	 *	@note	with SetPrediction(true), a clear attack from silence is
+	 *			notified at once. it stays until the vote settles on a
+	 *			value, which replaces it if different.
+	 *	@param	timestamp	capture time of the frame. see EdgeTime()
 	 */
-	bool Input(uint16_t value, uint16_t volume);
-	uint16_t CurrentNote();
-	void Reset();
+	bool Input(uint16_t value, uint16_t volume, Fp_t clarity, uint16_t timestamp)
+	{
+		bool onset = _od.Input(volume);
+		if (!_vc.Input(volume)) {
+			// cutoff to small value
+			value = 0;
+		}
+
+		uint16_t voted = 0;
+		uint16_t since = timestamp;
+		bool continued = _cd.Input(value, timestamp, &voted, &since);
+
+		if (continued && _lastNotifiedVal != voted) {
+			// enough frames agreed
+			_lastNotifiedVal = voted;
+			_edgeTime = since;
+			return true;
+		}
+
+		if (_predict && onset && _lastNotifiedVal == 0 && value != 0 && PREDICT_CLARITY_TH <= clarity) {
+			// clear attack from silence. don't wait for continuity.
+			// held notes are left to the vote so that a glitch with a volume blip doesn't cut them.
+			// a wrong guess is taken back by the next vote like any note
+			_lastNotifiedVal = value;
+			_edgeTime = timestamp;
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	 *	notify attacks from silence on their first frame. off by default
+	 */
+	void SetPrediction(bool on)
+	{
+		_predict = on;
+	}
+
+	uint16_t CurrentNote()
+	{
+		return _lastNotifiedVal;
+	}
+
+	/**
+	 *	when the note of the last edge began. capture time of the first
+	 *	frame voting for it, not of the frame the vote completed on
+	 */
+	uint16_t EdgeTime()
+	{
+		return _edgeTime;
+	}
+
+	void Reset()
+	{
+		_vc.Input(0);
+		_cd.Reset();
+		_od.Reset();
+		_lastNotifiedVal = 0;
+		_edgeTime = 0;
+	}
 
 private:
 	uint16_t _lastNotifiedVal;
-	ContinuityDetector* _cd;
-	VolumeComparator* _vc;
+	uint16_t _edgeTime;
+	bool _predict;
+	ContinuityDetector<HistoryLen, Agreement> _cd;
+	VolumeComparator _vc;
+	OnsetDetector _od;
 };
 
 #endif
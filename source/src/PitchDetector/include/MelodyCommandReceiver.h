@@ -2,6 +2,13 @@
 #define _MELODYCOMMANDRECEIVER_H_
 
 #include <stdint.h>
+#include "MelodyDetector.h"
+
+#define MELODY_COMMAND_MAX	16
+#define MELODY_STATE_MAX	64		// automaton states. sum of melody0 lengths + 1 at most
+#define MELODY_SYMBOL_MAX	16		// distinct notes or intervals used in melody0
+#define MELODY_NOTE_NUM		128		// midi note range
+#define MELODY_INTERVAL_BIAS	64	// interval to index of symbol table. +-5 octaves
 
 typedef uint8_t MelodyCommandEvent_t;
 
@@ -26,8 +33,13 @@ typedef struct MelodyCommandResponse_tag {
 	}
 } MelodyCommandResponse_t;
 
-class ResponsiveMelodyDetector;
-
+/**
+ *	melody0 of all commands are compiled into one aho-corasick automaton
+ *	over notes, or over intervals in interval mode.
+ *	each note costs one table lookup regardless of command number.
+ *	tolerant matching runs a MelodyDetector per command instead.
+ *	melody1 of the excited command is then matched by MelodyDetector.
+ */
 class MelodyCommandReceiver
 {
 public:
@@ -35,20 +47,40 @@ public:
 	MelodyCommandReceiver(const MelodyCommand_t* commands, int length);
 	~MelodyCommandReceiver();
 
-	bool Initialize(const MelodyCommand_t* commands, int length);
+	/**
+	 *	mode and tolerance are passed to MelodyDetector
+	 *	@return false when commands exceed MELODY_*_MAX. no command is set then
+	 */
+	bool Initialize(const MelodyCommand_t* commands, int length, uint8_t mode = kMelodyMatchExact, uint8_t tolerance = 0);
 	MelodyCommandResponse_t Input(uint16_t value);
 
 private:
-	int _commandNum;
-	ResponsiveMelodyDetector** _commands;
+	uint8_t _commandNum;
+	uint8_t _mode;
+	uint8_t _tolerance;
+	MelodyCommand_t _commands[MELODY_COMMAND_MAX];
+	uint8_t _symbols[MELODY_NOTE_NUM];		// note, or interval + MELODY_INTERVAL_BIAS, to symbol
+	uint8_t _next[MELODY_STATE_MAX][MELODY_SYMBOL_MAX];	// state transition
+	uint8_t _output[MELODY_STATE_MAX];		// command index whose melody0 ends at the state
+	uint8_t _state;
+	uint16_t _lastValue;		// previous note for interval. 0 if none
+	MelodyDetector _detectors[MELODY_COMMAND_MAX];	// used when tolerance is given
+	MelodyDetector _excited;
 	uint8_t _excitedIdx;
 	typedef MelodyCommandResponse_t(MelodyCommandReceiver::*InputFunc_t)(uint16_t);
+	InputFunc_t _baseFunc;
 	InputFunc_t _inputFunc;
 
+	MelodyCommandResponse_t IdleStateInput(uint16_t value);
 	MelodyCommandResponse_t BaseStateInput(uint16_t value);
+	MelodyCommandResponse_t TolerantBaseStateInput(uint16_t value);
 	MelodyCommandResponse_t ExcitedStateInput(uint16_t value);
 
+	uint8_t KeyOf(uint16_t prev, uint16_t value);
+	bool Compile();
+	MelodyCommandResponse_t Excite(uint8_t idx, uint16_t value);
 	void ResetAllDetectors();
+	void Clear();
 };
 
 #endif
@@ -5,24 +5,48 @@
 
 #define MAX_MELODY_LENGTH	8
 
+typedef enum {
+	kMelodyMatchExact,		// compare midi notes
+	kMelodyMatchInterval,	// compare successive note differences. transposition invariant
+	kMelodyMatchNum
+} MelodyMatchMode_t;
+
+/**
+ *	approximate matching of a melody anywhere in input notes.
+ *	keeps one edit distance column so per-note cost is melody length.
+ */
 class MelodyDetector
 {
 public:
-	MelodyDetector(const uint16_t* melody, uint8_t melodyLen);
+	MelodyDetector();
+	MelodyDetector(const uint16_t* melody, uint8_t melodyLen, uint8_t mode = kMelodyMatchExact, uint8_t tolerance = 0);
 	~MelodyDetector();
 
+	/**
+	 *	tolerance is edits(wrong, missing or extra) allowed.
+	 *	it is limited so that more than half of melody, and at least 3 notes or intervals, match.
+	 *	in interval mode a wrong note changes two intervals.
+	 */
+	void Set(const uint16_t* melody, uint8_t melodyLen, uint8_t mode = kMelodyMatchExact, uint8_t tolerance = 0);
 	/**
 	 *	@return -1:state backed to initial
 	 *	@return 0:state not changed
 	 *	@return 1:detected and state backed to initial
 	 */
 	int Input(uint16_t value);
+	/**
+	 *	give preceding note without matching. interval mode measures next note from it
+	 */
+	void Prime(uint16_t value);
 	void Reset();
 
 private:
-	uint8_t _melodyLength;
-	uint8_t _pos;
-	uint16_t _melody[MAX_MELODY_LENGTH];
+	uint8_t _patternLength;
+	uint8_t _mode;
+	uint8_t _tolerance;
+	uint16_t _lastValue;		// 0 if none
+	int16_t _pattern[MAX_MELODY_LENGTH];	// notes or intervals
+	uint8_t _dist[MAX_MELODY_LENGTH + 1];	// edit distance of each pattern prefix ending at last input
 };
 
 #endif
@@ -33,6 +33,7 @@
 #define T_PER_SAMPLE		FLOAT2FP(7.699616750081382e-05)	// factor to compute index to freq
 #define FREQ_PER_SAMPLE		(12988)			// 12987.659418105848 casted to int
 #define FREQ_PER_1024SAMPLE	13299363
+#define CENTS_PER_1024SAMPLE	396163		// 1200*16*log2(FREQ_PER_1024SAMPLE/freq of midi note 0)
 #endif
 #if 1	// GR-KURUMI with min,max
 #define N					256		// fft sampling num(last half is 0 pad)
@@ -41,6 +42,7 @@
 #define T_PER_SAMPLE		FLOAT2FP(7.54174232483e-05f)	// factor to compute index to freq
 #define FREQ_PER_SAMPLE		(13260)			// rounded
 #define FREQ_PER_1024SAMPLE	13577764		// rounded 
+#define CENTS_PER_1024SAMPLE	396737		// 1200*16*log2(FREQ_PER_1024SAMPLE/freq of midi note 0)
 #endif
 
 #define N2					(N/2)	// sampling num of analog input
@@ -59,12 +61,27 @@
 // debug
 #define DEBUG_OUTPUT_NUM    128
 
+#define PITCH_CANDIDATE_NUM	3
+
+// PitchInfo_t.cents is fixed point of 1/(1 << CENTS_SHFT) cent
+#define CENTS_SHFT			4
+#define CENTS_UNKNOWN		INT16_MIN
+
+typedef struct PitchCandidate_tag {
+	uint16_t freq;
+	Fp_t clarity;		// nsdf height. FPONE for perfectly periodic signal
+} PitchCandidate_t;
+
 typedef struct PitchInfo_tag {
 	uint16_t freq;
 	uint8_t midiNote;
 	const char* noteStr;
 	uint16_t volume;	// 0-1023
-	int8_t pitch;		// INT8_MIN,-1,0,1
+	int16_t cents;		// deviation from midiNote. CENTS_UNKNOWN if not detected
+	Fp_t clarity;		// nsdf height of freq
+	uint8_t candidateNum;
+	PitchCandidate_t candidates[PITCH_CANDIDATE_NUM];	// descending clarity
+	uint16_t timestamp;	// low 16 bits of millis when capture started. set by caller
 } PitchInfo_t;
 
 inline PitchInfo_t MakePitchInfo() {
@@ -73,7 +90,11 @@ inline PitchInfo_t MakePitchInfo() {
 	info.midiNote = 0;
 	info.noteStr = '\0';
 	info.volume = 0;
-	info.pitch = 0;
+	info.cents = CENTS_UNKNOWN;
+	info.clarity = 0;
+	info.candidateNum = 0;
+	memset(info.candidates, 0, sizeof(info.candidates));
+	info.timestamp = 0;
 
 	return info;
 }
@@ -5,6 +5,24 @@
 
 typedef struct _OsakanaFpFftContext_t OsakanaFpFftContext_t;
 typedef struct _MachineContextFp_t MachineContextFp_t;
+typedef struct _PeakInfoFp_t PeakInfoFp_t;
+
+// fft plans in ascending size. the largest one is N and used when pitch is uncertain
+#define PITCH_PLAN_NUM		2
+// frames of lag history used to reject octave errors. median of 3 is taken
+#define PITCH_HISTORY_LEN	3
+
+// reference pitch of A4 in Hz
+#define TUNING_REF_MIN		415
+#define TUNING_REF_MAX		466
+#define TUNING_REF_DEFAULT	440
+
+typedef enum {
+	kTemperamentEqual,
+	kTemperamentJust,
+	kTemperamentPythagorean,
+	kTemperamentNum
+} Temperament_t;
 
 typedef int (*ReadFpDataFunc_t)(Fp_t* data, uint8_t stride, const int dataNum, Fp_t* rawdata_min, Fp_t* rawdata_max);
 
@@ -16,13 +34,26 @@ public:
 	virtual int Initialize(void* readFunc);
 	virtual void Cleanup();
 	virtual int DetectPitch(PitchInfo_t* pitchInfo);
+	/**
+	 *	change note mapping. A4 is refFreq and other notes follow temperament built on tonic(0:C - 11:B)
+	 */
+	int SetTuning(uint16_t refFreq, uint8_t temperament, uint8_t tonic);
 
 private:
-	OsakanaFpFftContext_t* _fft;
+	OsakanaFpFftContext_t* _fft[PITCH_PLAN_NUM];
 	MachineContextFp_t* _det;
 	ReadFpDataFunc_t _func;
+	uint16_t _lastLag;		// lag of last detected pitch. 0 if none
+	Fp_t _lastClarity;		// nsdf height of last detected pitch
+	int16_t _noteCents[12];	// offset of each pitch class from A440 equal temperament in 1/16 cent
+	uint16_t _lagHistory[PITCH_HISTORY_LEN];	// lags picked by McLeod's rule. 0 if none
+	uint8_t _lagHistoryIdx;
 
-	int8_t GetAccuracy(uint16_t note, uint16_t idx8);
+	uint8_t SelectPlan();
+	int CorrectOctave(const PeakInfoFp_t* keyMaxs, int keyMaxLen, int sel);
+	uint16_t RecentLag();
+	void PushLag(uint16_t lag);
+	uint8_t NearestNote(int32_t cents, int16_t* deviation);
 };
 
 #endif
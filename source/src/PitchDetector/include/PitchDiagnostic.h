@@ -13,21 +13,26 @@ typedef uint8_t DiagnoseResult_t;
 class PitchDiagnostic
 {
 public:
-	PitchDiagnostic(uint16_t interval);
+	/**
+	 *	interval: frames averaged for one result
+	 *	tolerance: average deviation regarded as good, same unit as cents
+	 */
+	PitchDiagnostic(uint16_t interval, int16_t tolerance);
 	~PitchDiagnostic();
-	DiagnoseResult_t Diagnose(int8_t pitch, uint8_t note);
+	DiagnoseResult_t Diagnose(int16_t cents, uint8_t note);
 	void Reset();
 
 private:
 	const uint16_t kInterval;
+	const int16_t kTolerance;
 	uint16_t _interval;
-	int16_t _sum;
+	int32_t _sum;
 	uint8_t _note;
-	typedef DiagnoseResult_t(PitchDiagnostic::*func_t)(int8_t, uint8_t);
+	typedef DiagnoseResult_t(PitchDiagnostic::*func_t)(int16_t, uint8_t);
 	func_t _func;
 
-	DiagnoseResult_t diagnoseNoteOnState(int8_t pitch, uint8_t note);
-	DiagnoseResult_t diagnoseNoteOffState(int8_t pitch, uint8_t note);
+	DiagnoseResult_t diagnoseNoteOnState(int16_t cents, uint8_t note);
+	DiagnoseResult_t diagnoseNoteOffState(int16_t cents, uint8_t note);
 };
 
 #endif
@@ -0,0 +1,43 @@
+#ifndef _SILENCEGATE_H_
+#define _SILENCEGATE_H_
+
+#include <stdint.h>
+#include "VolumeComparator.h"
+
+/**
+ *	voice activity gate driven by rms of each captured frame.
+ *	Accumulate() every raw adc sample between Begin() and End().
+ */
+class SilenceGate
+{
+public:
+	SilenceGate(uint16_t off2OnRms, uint16_t on2OffRms);
+	~SilenceGate();
+
+	void Begin();
+	inline void Accumulate(uint16_t raw)
+	{
+		int16_t val = (int16_t)(raw & 0x3FF) - 512;
+		_sum += val;
+		_sumSq += (uint32_t)((int32_t)val * val);
+		_num++;
+	}
+	/**
+	 *	close the frame and update gate state
+	 *	@return	true if voice present(gate open)
+	 */
+	bool End();
+	bool IsOpen();
+	uint16_t Rms();
+	void Reset();
+
+private:
+	int32_t _sum;
+	uint32_t _sumSq;
+	uint16_t _num;
+	uint16_t _rms;
+	bool _isOpen;
+	VolumeComparator _vc;
+};
+
+#endif
@@ -2,22 +2,88 @@
 #define _CONTINUITYDETECTOR_H_
 
 #include <stdint.h>
+#include <string.h>
 
-#define HISTROY_LEN	3
-
+/**
+ *	votes on last HistoryLen values.
+ *	a value wins when it appears Agreement times or more.
+ *	HistoryLen == Agreement requires all identical values.
+ *	each value carries the time it was taken so that the start of the
+ *	winning run can be told.
+ */
+template <uint8_t HistoryLen, uint8_t Agreement>
 class ContinuityDetector
 {
 public:
-	ContinuityDetector();
-	~ContinuityDetector();
+	ContinuityDetector() : _historyIndex(0)
+	{
+		memset(_history, 0, sizeof(_history));
+		memset(_times, 0, sizeof(_times));
+	}
+
 	/**
-	@returns true if three identical values continued
+	@param time when val was taken
+	@returns true if a value won the vote. the value is set to voted and
+			 time of its oldest appearance in history to since
 	*/
-	bool Input(uint16_t val);
-	void Reset();
+	bool Input(uint16_t val, uint16_t time, uint16_t* voted, uint16_t* since)
+	{
+		_history[_historyIndex] = val;
+		_times[_historyIndex] = time;
+		_historyIndex = (_historyIndex + 1) % HistoryLen;
+
+		// latest value first so that it wins a tie
+		if (Agreement <= Count(val)) {
+			*voted = val;
+			*since = Since(val);
+			return true;
+		}
+		for (uint8_t i = 0; i < HistoryLen; i++) {
+			if (_history[i] != val && Agreement <= Count(_history[i])) {
+				*voted = _history[i];
+				*since = Since(_history[i]);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void Reset()
+	{
+		_historyIndex = 0;
+		memset(_history, 0, sizeof(_history));
+		memset(_times, 0, sizeof(_times));
+	}
+
 private:
-	uint16_t _history[HISTROY_LEN];
-	uint16_t _historyIndex;
+	uint16_t _history[HistoryLen];
+	uint16_t _times[HistoryLen];
+	uint8_t _historyIndex;
+
+	/**
+	 *	_historyIndex points the oldest entry after Input
+	 */
+	uint16_t Since(uint16_t val)
+	{
+		for (uint8_t i = 0; i < HistoryLen; i++) {
+			uint8_t idx = (_historyIndex + i) % HistoryLen;
+			if (_history[idx] == val) {
+				return _times[idx];
+			}
+		}
+		return 0;
+	}
+
+	uint8_t Count(uint16_t val)
+	{
+		uint8_t count = 0;
+		for (uint8_t i = 0; i < HistoryLen; i++) {
+			if (_history[i] == val) {
+				count++;
+			}
+		}
+		return count;
+	}
 };
 
 #endif
@@ -0,0 +1,15 @@
+#ifndef _LOG2CENTTABLE_H_
+#define _LOG2CENTTABLE_H_
+
+#define LOG2CENT_TABLE_BITS	5
+
+// 1200*log2(1 + i/32) in 1/16 cent. linear interpolation error is within 0.25 cent
+static const uint16_t kLog2CentTable[(1 << LOG2CENT_TABLE_BITS) + 1] = {
+	    0,   852,  1679,  2482,  3263,  4022,  4760,  5480,
+	 6181,  6865,  7532,  8184,  8821,  9444, 10052, 10648,
+	11231, 11802, 12362, 12911, 13448, 13976, 14494, 15002,
+	15501, 15991, 16473, 16947, 17412, 17870, 18321, 18764,
+	19200
+};
+
+#endif
@@ -1,60 +1,197 @@
 #include "MelodyCommandReceiver.h"
-#include "ResponsiveMelodyDetector.h"
+
+#if defined(ARDUINO_PLATFORM) || defined(RLDUINO78_VERSION) || defined(ARDUINO)      // arduino
+#include <Arduino.h>
+#else
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#endif
+
+using namespace std;
 
 static const MelodyCommandResponse_t kEmptyResp = { 0,0 };
 
+static const uint8_t kNone = 0xFF;
+
 MelodyCommandReceiver::MelodyCommandReceiver(const MelodyCommand_t* commands, int length)
 	:
-	_commandNum(length),
-	_commands(NULL)
+	_commandNum(0),
+	_mode(kMelodyMatchExact),
+	_tolerance(0),
+	_state(0),
+	_lastValue(0),
+	_excitedIdx(0),
+	_baseFunc(&MelodyCommandReceiver::IdleStateInput),
+	_inputFunc(&MelodyCommandReceiver::IdleStateInput)
 {
+	Clear();
 	Initialize(commands, length);
 }
 
 MelodyCommandReceiver::MelodyCommandReceiver()
 	:
-	_commandNum(0)
+	_commandNum(0),
+	_mode(kMelodyMatchExact),
+	_tolerance(0),
+	_state(0),
+	_lastValue(0),
+	_excitedIdx(0),
+	_baseFunc(&MelodyCommandReceiver::IdleStateInput),
+	_inputFunc(&MelodyCommandReceiver::IdleStateInput)
 {
-	_commands = NULL;
+	// no command matches until Initialize()
+	Clear();
 }
 
 MelodyCommandReceiver::~MelodyCommandReceiver()
 {
-	for (int i = 0; i < _commandNum; i++) {
-		delete _commands[i];
-	}
-	free(_commands);
-	_commands = NULL;
 }
 
-bool MelodyCommandReceiver::Initialize(const MelodyCommand_t* commands, int length)
+bool MelodyCommandReceiver::Initialize(const MelodyCommand_t* commands, int length, uint8_t mode, uint8_t tolerance)
 {
-	if (_commands != NULL) {
+	if (_commandNum != 0 || MELODY_COMMAND_MAX < length || kMelodyMatchNum <= mode) {
 		return false;
 	}
+	// empty pattern would match every note. an interval needs 2 notes
+	uint8_t minLen = (mode == kMelodyMatchInterval) ? 2 : 1;
+	for (int i = 0; i < length; i++) {
+		if (commands[i].melody0_len < minLen) {
+			return false;
+		}
+	}
 
-	_commandNum = length;
-	_commands = static_cast<ResponsiveMelodyDetector**>(malloc(sizeof(ResponsiveMelodyDetector*) * length));
-	for (int i = 0; i < _commandNum; i++) {
-		const MelodyCommand_t* cmd = &(commands[i]);
-		_commands[i] = new ResponsiveMelodyDetector(cmd->melody0, cmd->melody0_len, cmd->melody1, cmd->melody1_len);
+	_commandNum = (uint8_t)length;
+	_mode = mode;
+	_tolerance = tolerance;
+	memcpy(_commands, commands, sizeof(MelodyCommand_t) * length);
+	if (_tolerance == 0) {
+		if (!Compile()) {
+			Clear();
+			return false;
+		}
+		_baseFunc = &MelodyCommandReceiver::BaseStateInput;
+	}
+	else {
+		for (uint8_t i = 0; i < _commandNum; i++) {
+			_detectors[i].Set(_commands[i].melody0, _commands[i].melody0_len, _mode, _tolerance);
+		}
+		_baseFunc = &MelodyCommandReceiver::TolerantBaseStateInput;
 	}
 	ResetAllDetectors();
 
 	return true;
 }
 
+/**
+ *	note, or interval from prev in interval mode, as index of _symbols.
+ *	MELODY_NOTE_NUM if out of range
+ */
+uint8_t MelodyCommandReceiver::KeyOf(uint16_t prev, uint16_t value)
+{
+	if (_mode == kMelodyMatchInterval) {
+		int16_t interval = (int16_t)value - (int16_t)prev;
+		if (interval < -MELODY_INTERVAL_BIAS || MELODY_NOTE_NUM - MELODY_INTERVAL_BIAS <= interval) {
+			return MELODY_NOTE_NUM;
+		}
+		return (uint8_t)(interval + MELODY_INTERVAL_BIAS);
+	}
+	return (value < MELODY_NOTE_NUM) ? (uint8_t)value : MELODY_NOTE_NUM;
+}
+
+/**
+ *	build trie of melody0 then turn it into a dfa by filling failure transitions.
+ *	symbols are notes, or intervals between them in interval mode
+ */
+bool MelodyCommandReceiver::Compile()
+{
+	memset(_symbols, kNone, sizeof(_symbols));
+	memset(_next, kNone, sizeof(_next));
+	memset(_output, kNone, sizeof(_output));
+
+	// trie
+	uint8_t first = (_mode == kMelodyMatchInterval) ? 1 : 0;
+	uint8_t symbolNum = 0;
+	uint8_t stateNum = 1;
+	for (uint8_t i = 0; i < _commandNum; i++) {
+		const MelodyCommand_t* cmd = &_commands[i];
+		uint8_t s = 0;
+		for (uint8_t j = first; j < cmd->melody0_len; j++) {
+			uint8_t key = KeyOf(first ? cmd->melody0[j - 1] : 0, cmd->melody0[j]);
+			if (MELODY_NOTE_NUM <= key) {
+				return false;
+			}
+			if (_symbols[key] == kNone) {
+				if (MELODY_SYMBOL_MAX <= symbolNum) {
+					return false;
+				}
+				_symbols[key] = symbolNum++;
+			}
+			uint8_t sym = _symbols[key];
+			if (_next[s][sym] == kNone) {
+				if (MELODY_STATE_MAX <= stateNum) {
+					return false;
+				}
+				_next[s][sym] = stateNum++;
+			}
+			s = _next[s][sym];
+		}
+		if (_output[s] == kNone) {
+			_output[s] = i;
+		}
+	}
+
+	// failure links in breadth first order. states in queue have their fail set
+	uint8_t fail[MELODY_STATE_MAX];
+	uint8_t queue[MELODY_STATE_MAX];
+	uint8_t head = 0;
+	uint8_t tail = 0;
+	for (uint8_t sym = 0; sym < MELODY_SYMBOL_MAX; sym++) {
+		uint8_t t = _next[0][sym];
+		if (t == kNone) {
+			_next[0][sym] = 0;
+		}
+		else {
+			fail[t] = 0;
+			queue[tail++] = t;
+		}
+	}
+	while (head < tail) {
+		uint8_t s = queue[head++];
+		for (uint8_t sym = 0; sym < MELODY_SYMBOL_MAX; sym++) {
+			uint8_t t = _next[s][sym];
+			if (t == kNone) {
+				_next[s][sym] = _next[fail[s]][sym];
+			}
+			else {
+				fail[t] = _next[fail[s]][sym];
+				if (_output[t] == kNone) {
+					// a melody ending as suffix of this path
+					_output[t] = _output[fail[t]];
+				}
+				queue[tail++] = t;
+			}
+		}
+	}
+	return true;
+}
+
 MelodyCommandResponse_t MelodyCommandReceiver::Input(uint16_t value)
 {
 	return (this->*_inputFunc)(value);
 }
 
+/**
+ *	no command is set
+ */
+MelodyCommandResponse_t MelodyCommandReceiver::IdleStateInput(uint16_t value)
+{
+	return kEmptyResp;
+}
+
 MelodyCommandResponse_t MelodyCommandReceiver::ExcitedStateInput(uint16_t value)
 {
-	ResponsiveMelodyDetector* det = _commands[_excitedIdx];
-	int result = det->Input(value);
+	int result = _excited.Input(value);
 
 	MelodyCommandResponse_t resp = kEmptyResp;
 	switch (result) {
@@ -63,7 +200,7 @@ MelodyCommandResponse_t MelodyCommandReceiver::ExcitedStateInput(uint16_t value)
 	case -1:
 		ResetAllDetectors();
 		break;
-	case 2:
+	case 1:
 		resp.evt = kMelodyCommandEvtFired;
 		resp.commandIdx = _excitedIdx;
 		ResetAllDetectors();
@@ -78,27 +215,106 @@ MelodyCommandResponse_t MelodyCommandReceiver::ExcitedStateInput(uint16_t value)
 MelodyCommandResponse_t MelodyCommandReceiver::BaseStateInput(uint16_t value)
 {
 	MelodyCommandResponse_t resp = kEmptyResp;
+	if (value == 0) {
+		return resp;
+	}
+
+	uint16_t prev = _lastValue;
+	_lastValue = value;
+	if (_mode == kMelodyMatchInterval && prev == 0) {
+		// first note only gives reference
+		return resp;
+	}
+
+	uint8_t key = KeyOf(prev, value);
+	uint8_t sym = (key < MELODY_NOTE_NUM) ? _symbols[key] : kNone;
+	if (sym == kNone) {
+		// note or interval not used by any command
+		_state = 0;
+		return resp;
+	}
+
+	_state = _next[_state][sym];
+	uint8_t idx = _output[_state];
+	if (idx != kNone) {
+		_state = 0;
+		return Excite(idx, value);
+	}
+
+	return resp;
+}
+
+MelodyCommandResponse_t MelodyCommandReceiver::TolerantBaseStateInput(uint16_t value)
+{
+	MelodyCommandResponse_t resp = kEmptyResp;
+	if (value == 0) {
+		return resp;
+	}
 
-	for (int i = 0; i < _commandNum; i++) {
-		ResponsiveMelodyDetector* det = _commands[i];
-		if (det->Input(value) == 1) {
-			resp.commandIdx = i;
-			resp.evt = kMelodyCommandEvtExcited;
-			_inputFunc = &MelodyCommandReceiver::ExcitedStateInput;
-			_excitedIdx = i;
-			return resp;
+	// every detector must see every note to keep its distance column
+	uint8_t excitedIdx = kNone;
+	for (uint8_t i = 0; i < _commandNum; i++) {
+		if (_detectors[i].Input(value) == 1 && excitedIdx == kNone) {
+			excitedIdx = i;
 		}
 	}
+	if (excitedIdx != kNone) {
+		return Excite(excitedIdx, value);
+	}
+
+	return resp;
+}
+
+/**
+ *	melody0 of command idx matched with value as its last note
+ */
+MelodyCommandResponse_t MelodyCommandReceiver::Excite(uint8_t idx, uint16_t value)
+{
+	MelodyCommandResponse_t resp = kEmptyResp;
+	resp.commandIdx = idx;
+	resp.evt = kMelodyCommandEvtExcited;
+	_inputFunc = &MelodyCommandReceiver::ExcitedStateInput;
+	_excitedIdx = idx;
+
+	const MelodyCommand_t* cmd = &_commands[idx];
+	if (_mode == kMelodyMatchInterval) {
+		// first interval of melody1 is from the last note of melody0
+		uint16_t melody[MAX_MELODY_LENGTH];
+		uint8_t len = min((int)cmd->melody1_len, MAX_MELODY_LENGTH - 1);
+		melody[0] = cmd->melody0[cmd->melody0_len - 1];
+		memcpy(&melody[1], cmd->melody1, sizeof(uint16_t) * len);
+		_excited.Set(melody, len + 1, _mode, _tolerance);
+		_excited.Prime(value);
+	}
+	else {
+		_excited.Set(cmd->melody1, cmd->melody1_len, _mode, _tolerance);
+	}
 
 	return resp;
 }
 
 void MelodyCommandReceiver::ResetAllDetectors()
 {
-	for (int i = 0; i < _commandNum; i++) {
-		ResponsiveMelodyDetector* det = _commands[i];
-		det->Reset();
+	_state = 0;
+	_lastValue = 0;
+	for (uint8_t i = 0; i < _commandNum; i++) {
+		_detectors[i].Reset();
 	}
+	_excited.Reset();
 	_excitedIdx = 0;
-	_inputFunc = &MelodyCommandReceiver::BaseStateInput;
+	_inputFunc = _baseFunc;
+}
+
+/**
+ *	forget commands and half built tables. Input() answers nothing until Initialize()
+ */
+void MelodyCommandReceiver::Clear()
+{
+	_commandNum = 0;
+	memset(_commands, 0, sizeof(_commands));
+	memset(_symbols, kNone, sizeof(_symbols));
+	memset(_next, 0, sizeof(_next));
+	memset(_output, kNone, sizeof(_output));
+	_baseFunc = &MelodyCommandReceiver::IdleStateInput;
+	ResetAllDetectors();
 }
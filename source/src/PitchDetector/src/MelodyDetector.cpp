@@ -5,46 +5,123 @@
 #include <Arduino.h>
 #else
 #include <cstdlib>
+#include <cstring>
 #include <algorithm>
 #endif
 
 
 using namespace std;
 
-MelodyDetector::MelodyDetector(const uint16_t* melody, uint8_t melodyLen)
+// symbols that must match exactly when tolerance is given
+#define MIN_MATCH_NUM	3
+
+MelodyDetector::MelodyDetector()
+	:
+	_patternLength(0),
+	_mode(kMelodyMatchExact),
+	_tolerance(0),
+	_lastValue(0)
+{
+	memset(_pattern, 0, sizeof(_pattern));
+	Reset();
+}
+
+MelodyDetector::MelodyDetector(const uint16_t* melody, uint8_t melodyLen, uint8_t mode, uint8_t tolerance)
 	:
-	_melodyLength(melodyLen),
-	_pos(0)
+	_patternLength(0),
+	_mode(kMelodyMatchExact),
+	_tolerance(0),
+	_lastValue(0)
 {
-	memset(_melody, 0, sizeof(_melody));
-	memcpy(_melody, melody, sizeof(uint16_t) * min(melodyLen, (uint8_t)MAX_MELODY_LENGTH));
+	Set(melody, melodyLen, mode, tolerance);
 }
 
 MelodyDetector::~MelodyDetector()
 {
 }
 
+void MelodyDetector::Set(const uint16_t* melody, uint8_t melodyLen, uint8_t mode, uint8_t tolerance)
+{
+	melodyLen = min(melodyLen, (uint8_t)MAX_MELODY_LENGTH);
+	_mode = mode;
+	memset(_pattern, 0, sizeof(_pattern));
+
+	if (_mode == kMelodyMatchInterval) {
+		_patternLength = (0 < melodyLen) ? melodyLen - 1 : 0;
+		for (uint8_t i = 0; i < _patternLength; i++) {
+			_pattern[i] = (int16_t)melody[i + 1] - (int16_t)melody[i];
+		}
+	}
+	else {
+		_patternLength = melodyLen;
+		for (uint8_t i = 0; i < _patternLength; i++) {
+			_pattern[i] = (int16_t)melody[i];
+		}
+	}
+
+	// more than half and at least MIN_MATCH_NUM symbols of pattern must match
+	uint8_t maxTolerance = 0;
+	if (MIN_MATCH_NUM < _patternLength) {
+		maxTolerance = min((uint8_t)((_patternLength - 1) >> 1), (uint8_t)(_patternLength - MIN_MATCH_NUM));
+	}
+	_tolerance = min(tolerance, maxTolerance);
+	Reset();
+}
+
 int MelodyDetector::Input(uint16_t value)
 {
 	if (value == 0) {
 		return 0;
 	}
 
-	if (_melody[_pos] != value) {
-		_pos = 0;
-		return -1;
+	int16_t symbol = (int16_t)value;
+	if (_mode == kMelodyMatchInterval) {
+		uint16_t last = _lastValue;
+		_lastValue = value;
+		if (last == 0) {
+			// first note only gives reference
+			return 0;
+		}
+		symbol = (int16_t)value - (int16_t)last;
+	}
+
+	// sellers' algorithm. match may start anywhere so row 0 stays 0
+	uint8_t diag = _dist[0];
+	bool progressed = false;
+	for (uint8_t i = 1; i <= _patternLength; i++) {
+		uint8_t d = diag + ((_pattern[i - 1] == symbol) ? 0 : 1);
+		d = min(d, (uint8_t)(_dist[i] + 1));		// extra input note
+		d = min(d, (uint8_t)(_dist[i - 1] + 1));	// missing pattern note
+		diag = _dist[i];
+		_dist[i] = d;
+		if (d < i) {
+			progressed = true;
+		}
 	}
 
-	_pos++;
-	if (_pos == _melodyLength) {
-		_pos = 0;
+	// match must end on the last symbol. otherwise it fires before the melody ends
+	bool lastMatched = (0 < _patternLength) && (_pattern[_patternLength - 1] == symbol);
+	if (lastMatched && _dist[_patternLength] <= _tolerance) {
+		uint16_t last = _lastValue;
+		Reset();
+		Prime(last);
 		return 1;
 	}
 
-	return 0;
+	return progressed ? 0 : -1;
+}
+
+void MelodyDetector::Prime(uint16_t value)
+{
+	if (_mode == kMelodyMatchInterval) {
+		_lastValue = value;
+	}
 }
 
 void MelodyDetector::Reset()
 {
-	_pos = 0;
+	_lastValue = 0;
+	for (uint8_t i = 0; i <= MAX_MELODY_LENGTH; i++) {
+		_dist[i] = i;
+	}
 }
@@ -1,136 +0,0 @@
-#ifndef _NOTETABLE8_H_
-#define _NOTETABLE8_H_
-
-static const uint8_t kNoteTable8[] = {
-	0,164,152,145,140,136,133,130,
-	128,126,124,122,121,120,118,117,
-	116,115,114,113,112,111,110,110,
-	109,108,108,107,106,106,105,105,
-	104,103,103,102,102,101,101,101,
-	100,100,99,99,98,98,98,97,
-	97,97,96,96,96,95,95,95,
-	94,94,94,93,93,93,93,92,
-	92,92,91,91,91,91,90,90,
-	90,90,89,89,89,89,89,88,
-	88,88,88,87,87,87,87,87,
-	86,86,86,86,86,85,85,85,
-	85,85,85,84,84,84,84,84,
-	84,83,83,83,83,83,83,82,
-	82,82,82,82,82,82,81,81,
-	81,81,81,81,81,80,80,80,
-	80,80,80,80,79,79,79,79,
-	79,79,79,79,78,78,78,78,
-	78,78,78,78,77,77,77,77,
-	77,77,77,77,77,76,76,76,
-	76,76,76,76,76,76,75,75,
-	75,75,75,75,75,75,75,75,
-	74,74,74,74,74,74,74,74,
-	74,74,73,73,73,73,73,73,
-	73,73,73,73,73,72,72,72,
-	72,72,72,72,72,72,72,72,
-	72,71,71,71,71,71,71,71,
-	71,71,71,71,71,71,70,70,
-	70,70,70,70,70,70,70,70,
-	70,70,70,69,69,69,69,69,
-	69,69,69,69,69,69,69,69,
-	69,68,68,68,68,68,68,68,
-	68,68,68,68,68,68,68,67,
-	67,67,67,67,67,67,67,67,
-	67,67,67,67,67,67,67,66,
-	66,66,66,66,66,66,66,66,
-	66,66,66,66,66,66,66,66,
-	65,65,65,65,65,65,65,65,
-	65,65,65,65,65,65,65,65,
-	65,64,64,64,64,64,64,64,
-	64,64,64,64,64,64,64,64,
-	64,64,64,64,63,63,63,63,
-	63,63,63,63,63,63,63,63,
-	63,63,63,63,63,63,63,62,
-	62,62,62,62,62,62,62,62,
-	62,62,62,62,62,62,62,62,
-	62,62,62,62,61,61,61,61,
-	61,61,61,61,61,61,61,61,
-	61,61,61,61,61,61,61,61,
-	61,61,60,60,60,60,60,60,
-	60,60,60,60,60,60,60,60,
-	60,60,60,60,60,60,60,60,
-	60,60,59,59,59,59,59,59,
-	59,59,59,59,59,59,59,59,
-	59,59,59,59,59,59,59,59,
-	59,59,59,58,58,58,58,58,
-	58,58,58,58,58,58,58,58,
-	58,58,58,58,58,58,58,58,
-	58,58,58,58,58,57,57,57,
-	57,57,57,57,57,57,57,57,
-	57,57,57,57,57,57,57,57,
-	57,57,57,57,57,57,57,57,
-	57,56,56,56,56,56,56,56,
-	56,56,56,56,56,56,56,56,
-	56,56,56,56,56,56,56,56,
-	56,56,56,56,56,56,55,55,
-	55,55,55,55,55,55,55,55,
-	55,55,55,55,55,55,55,55,
-	55,55,55,55,55,55,55,55,
-	55,55,55,55,55,55,54,54,
-	54,54,54,54,54,54,54,54,
-	54,54,54,54,54,54,54,54,
-	54,54,54,54,54,54,54,54,
-	54,54,54,54,54,54,54,53,
-	53,53,53,53,53,53,53,53,
-	53,53,53,53,53,53,53,53,
-	53,53,53,53,53,53,53,53,
-	53,53,53,53,53,53,53,53,
-	53,53,52,52,52,52,52,52,
-	52,52,52,52,52,52,52,52,
-	52,52,52,52,52,52,52,52,
-	52,52,52,52,52,52,52,52,
-	52,52,52,52,52,52,52,51,
-	51,51,51,51,51,51,51,51,
-	51,51,51,51,51,51,51,51,
-	51,51,51,51,51,51,51,51,
-	51,51,51,51,51,51,51,51,
-	51,51,51,51,51,51,50,50,
-	50,50,50,50,50,50,50,50,
-	50,50,50,50,50,50,50,50,
-	50,50,50,50,50,50,50,50,
-	50,50,50,50,50,50,50,50,
-	50,50,50,50,50,50,50,50,
-	49,49,49,49,49,49,49,49,
-	49,49,49,49,49,49,49,49,
-	49,49,49,49,49,49,49,49,
-	49,49,49,49,49,49,49,49,
-	49,49,49,49,49,49,49,49,
-	49,49,49,49,48,48,48,48,
-	48,48,48,48,48,48,48,48,
-	48,48,48,48,48,48,48,48,
-	48,48,48,48,48,48,48,48,
-	48,48,48,48,48,48,48,48,
-	48,48,48,48,48,48,48,48,
-	48,48,48,47,47,47,47,47,
-	47,47,47,47,47,47,47,47,
-	47,47,47,47,47,47,47,47,
-	47,47,47,47,47,47,47,47,
-	47,47,47,47,47,47,47,47,
-	47,47,47,47,47,47,47,47,
-	47,47,47,47,47,46,46,46,
-	46,46,46,46,46,46,46,46,
-	46,46,46,46,46,46,46,46,
-	46,46,46,46,46,46,46,46,
-	46,46,46,46,46,46,46,46,
-	46,46,46,46,46,46,46,46,
-	46,46,46,46,46,46,46,46,
-	46,45,45,45,45,45,45,45,
-	45,45,45,45,45,45,45,45,
-	45,45,45,45,45,45,45,45,
-	45,45,45,45,45,45,45,45,
-	45,45,45,45,45,45,45,45,
-	45,45,45,45,45,45,45,45,
-	45,45,45,45,45,45,45,45,
-	45,44,44,44,44,44,44,44,
-	44,44,44,44,44,44,44,44,
-	44,44,44,44,44,44,44,44,
-	44,44,44,44,44,44,44,44
-};
-
-#endif
-
@@ -1,178 +0,0 @@
-#ifndef _NOTETABLE8INDEXRANGE_H_
-#define _NOTETABLE8INDEXRANGE_H_
-
-
-typedef struct NoteTableIndexRange_tag {
-	uint16_t min_idx;
-	uint16_t max_idx;
-} NoteTableIndexRange_t;
-
-static const NoteTableIndexRange_t kNoteTable8IndexRange[] = {
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 993,	1023},
-	{ 937,	992},
-	{ 885,	936},
-	{ 835,	884},
-	{ 788,	834},
-	{ 744,	787},
-	{ 702,	743},
-	{ 663,	701},
-	{ 626,	662},
-	{ 591,	625},
-	{ 558,	590},
-	{ 526,	557},
-	{ 497,	525},
-	{ 469,	496},
-	{ 443,	468},
-	{ 418,	442},
-	{ 394,	417},
-	{ 372,	393},
-	{ 351,	371},
-	{ 332,	350},
-	{ 313,	331},
-	{ 296,	312},
-	{ 279,	295},
-	{ 263,	278},
-	{ 249,	262},
-	{ 235,	248},
-	{ 222,	234},
-	{ 209,	221},
-	{ 197,	208},
-	{ 186,	196},
-	{ 176,	185},
-	{ 166,	175},
-	{ 157,	165},
-	{ 148,	156},
-	{ 140,	147},
-	{ 132,	139},
-	{ 125,	131},
-	{ 118,	124},
-	{ 111,	117},
-	{ 105,	110},
-	{ 99,	104},
-	{ 93,	98},
-	{ 88,	92},
-	{ 83,	87},
-	{ 79,	82},
-	{ 74,	78},
-	{ 70,	73},
-	{ 66,	69},
-	{ 63,	65},
-	{ 59,	62},
-	{ 56,	58},
-	{ 53,	55},
-	{ 50,	52},
-	{ 47,	49},
-	{ 44,	46},
-	{ 42,	43},
-	{ 40,	41},
-	{ 37,	39},
-	{ 35,	36},
-	{ 33,	34},
-	{ 32,	32},
-	{ 30,	31},
-	{ 28,	29},
-	{ 27,	27},
-	{ 25,	26},
-	{ 24,	24},
-	{ 22,	23},
-	{ 21,	21},
-	{ 20,	20},
-	{ 19,	19},
-	{ 18,	18},
-	{ 17,	17},
-	{ 16,	16},
-	{ 15,	15},
-	{ 14,	14},
-	{ 0,	0},
-	{ 13,	13},
-	{ 12,	12},
-	{ 11,	11},
-	{ 0,	0},
-	{ 10,	10},
-	{ 0,	0},
-	{ 9,	9},
-	{ 0,	0},
-	{ 8,	8},
-	{ 0,	0},
-	{ 7,	7},
-	{ 0,	0},
-	{ 0,	0},
-	{ 6,	6},
-	{ 0,	0},
-	{ 0,	0},
-	{ 5,	5},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 4,	4},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 3,	3},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 2,	2},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-	{ 0,	0},
-};
-
-#endif
-
@@ -0,0 +1,27 @@
+#include "OnsetDetector.h"
+
+OnsetDetector::OnsetDetector(uint16_t minRise)
+	:
+	_minRise(minRise),
+	_envelope(0)
+{
+}
+
+OnsetDetector::~OnsetDetector()
+{
+}
+
+bool OnsetDetector::Input(uint16_t volume)
+{
+	uint16_t env = _envelope;
+	// 1/4 IIR of volume
+	_envelope = env - (env >> 2) + (volume >> 2);
+
+	// energy rise. x1.5 of recent level and at least minRise
+	return (env + (env >> 1) <= volume) && (env + _minRise <= volume);
+}
+
+void OnsetDetector::Reset()
+{
+	_envelope = 0;
+}
@@ -0,0 +1,21 @@
+#ifndef _ONSETDETECTOR_H_
+#define _ONSETDETECTOR_H_
+
+#include <stdint.h>
+
+class OnsetDetector
+{
+public:
+	OnsetDetector(uint16_t minRise);
+	~OnsetDetector();
+	/**
+	 *	@return true when volume jumps above recent volume level
+	 */
+	bool Input(uint16_t volume);
+	void Reset();
+private:
+	const uint16_t _minRise;
+	uint16_t _envelope;		// smoothed volume of past frames
+};
+
+#endif
@@ -1,6 +1,8 @@
 
 #include "../include/OsakanaPitchDetectionFp.h"
 #include "PeakDetectMachineFp.h"
+#include "Log2CentTable.h"
+#include "TemperamentTable.h"
 
 #if defined(ARDUINO_PLATFORM) || defined(RLDUINO78_VERSION) || defined(ARDUINO)      // arduino
 #include <Arduino.h>
@@ -17,6 +19,15 @@ Fp_t x2[N2] = { 0 };
 Fp_t rawdata_min = 512;
 Fp_t rawdata_max = 0;
 
+// log2 of fft size for each plan. last one must be LOG2N
+static const uint8_t kPlanLog2N[PITCH_PLAN_NUM] = { LOG2N - 1, LOG2N };
+// smaller plan is used only when last pitch was clear enough
+#define PLAN_CLARITY_TH		FLOAT2FP(0.8f)
+// McLeod's k. the key maximum of smallest lag above k * global max is the pitch
+#define KEYMAX_K			FLOAT2FP(0.9f)
+// key maximum at recent lag beats an octave jump when above this ratio of global max
+#define HISTORY_K			FLOAT2FP(0.6f)
+
 int GetSourceSignalShiftScale(Fp_t amplitude)
 {
 	//Fp2CStr(amplitude, debug_output_buf_, sizeof(debug_output_buf_));
@@ -43,24 +54,125 @@ static inline Fp_t ScaleRawData(Fp_t rawData, int extraShft = 0) {
 	return (Fp_t)(rawData << (FPSHFT - 9 + extraShft));// div 512 then shift
 }
 
-static void PrintResult(uint16_t freq, const char* str, int8_t pitch)
+/**
+ *	lag of a nsdf key maximum refined by parabolic interpolation, x1024
+ */
+static int32_t InterpolatedLag1024(MachineContextFp_t* det, const PeakInfoFp_t* peak, Fp_t* nsdf, int sampleNum)
+{
+	Fp_t delta = 0;
+	ParabolicInterpFp(det, peak->index, nsdf, sampleNum, &delta);
+
+	// idx1024=1024*index
+	int32_t idx1024 = (int32_t)peak->index << 10;
+	// int expression of 1024*delta
+	idx1024 += (delta >> (FPSHFT - 10));
+	return idx1024;
+}
+
+static inline uint16_t Lag1024ToFreq(int32_t idx1024)
+{
+	// freq = freq_per_sample / idx
+	return (uint16_t)((FREQ_PER_1024SAMPLE + (idx1024 >> 1)) / idx1024);
+}
+
+/**
+ *	McLeod's rule. keyMaxs[0] is global max and the rest are in ascending lag
+ */
+static int SelectKeyMaximum(const PeakInfoFp_t* keyMaxs, int keyMaxLen)
+{
+	Fp_t th = FpMul(KEYMAX_K, keyMaxs[0].value);
+	int sel = 0;
+	for (int i = 1; i < keyMaxLen; i++) {
+		if (th <= keyMaxs[i].value && keyMaxs[i].index < keyMaxs[sel].index) {
+			sel = i;
+		}
+	}
+	return sel;
+}
+
+/**
+ *	lag is within about a semitone of ref
+ */
+static inline bool IsNearLag(uint16_t lag, uint16_t ref)
+{
+	uint16_t diff = (lag < ref) ? (ref - lag) : (lag - ref);
+	return diff <= (ref >> 4);
+}
+
+/**
+ *	1200*log2(val) in 1/16 cent. val must be positive
+ */
+static int32_t Log2Cents(uint32_t val)
+{
+	// val = 2^e * (1 + f)
+	int32_t e = 31;
+	while (!(val & 0x80000000UL)) {
+		val <<= 1;
+		e--;
+	}
+
+	// top bits of f index the table, next 8 bits interpolate
+	uint16_t idx = (uint16_t)(val >> (31 - LOG2CENT_TABLE_BITS)) & ((1 << LOG2CENT_TABLE_BITS) - 1);
+	int32_t frac = (int32_t)(val >> (31 - LOG2CENT_TABLE_BITS - 8)) & 0xFF;
+	int32_t lo = kLog2CentTable[idx];
+	int32_t hi = kLog2CentTable[idx + 1];
+	return e * (1200 << CENTS_SHFT) + lo + (((hi - lo) * frac) >> 8);
+}
+
+/**
+ *	cents above midi note 0 of lag x1024, in 1/16 cent
+ */
+static inline int32_t Lag1024ToCents(int32_t idx1024)
+{
+	// freq = FREQ_PER_1024SAMPLE / idx1024
+	return CENTS_PER_1024SAMPLE - Log2Cents((uint32_t)idx1024);
+}
+
+/**
+ *	fill candidates with key maximums in descending nsdf height
+ */
+static void FillCandidates(MachineContextFp_t* det, PeakInfoFp_t* keyMaxs, int keyMaxLen, Fp_t* nsdf, int sampleNum, PitchInfo_t* pitchInfo)
+{
+	// list is tiny. insertion sort
+	for (int i = 1; i < keyMaxLen; i++) {
+		PeakInfoFp_t peak = keyMaxs[i];
+		int j = i;
+		for (; 0 < j && keyMaxs[j - 1].value < peak.value; j--) {
+			keyMaxs[j] = keyMaxs[j - 1];
+		}
+		keyMaxs[j] = peak;
+	}
+
+	int num = min(keyMaxLen, PITCH_CANDIDATE_NUM);
+	for (int i = 0; i < num; i++) {
+		pitchInfo->candidates[i].freq = Lag1024ToFreq(InterpolatedLag1024(det, &keyMaxs[i], nsdf, sampleNum));
+		pitchInfo->candidates[i].clarity = keyMaxs[i].value;
+	}
+	pitchInfo->candidateNum = (uint8_t)num;
+}
+
+static void PrintResult(uint16_t freq, const char* str, int16_t cents)
 {
 #if defined(BROKEN_SPRINTF)
 	LOG_PRINTF("freq=");
 	LOG_PRINTF(freq, DEC);
 	LOG_PRINTF(", note=");
 	LOG_PRINTF(str);
-	LOG_PRINTF(", pitch=");
-	LOG_PRINTF(pitch, DEC);
+	LOG_PRINTF(", cents=");
+	LOG_PRINTF(cents >> CENTS_SHFT, DEC);
 	LOG_PRINTF(LOG_NEWLINE);
 #else
-	ILOG("freq=%u Hz, note=%s, pitch=%d\n", freq, str, (int)pitch);
+	ILOG("freq=%u Hz, note=%s, cents=%d\n", freq, str, (int)(cents >> CENTS_SHFT));
 #endif
 }
 
 PitchDetectorFp::PitchDetectorFp()
-	: _fft(NULL), _det(NULL), _func(NULL)
+	: _det(NULL), _func(NULL), _lastLag(0), _lastClarity(0), _lagHistoryIdx(0)
 {
+	memset(_fft, 0, sizeof(_fft));
+	memset(_lagHistory, 0, sizeof(_lagHistory));
+	// A440 equal temperament
+	memset(_noteCents, 0, sizeof(_noteCents));
 }
 
 PitchDetectorFp::~PitchDetectorFp()
@@ -72,9 +184,11 @@ int PitchDetectorFp::Initialize(void* readFunc)
 {
 	_det = CreatePeakDetectMachineContextFp();
 
-	if (InitOsakanaFpFft(&_fft, N, LOG2N) != 0) {
-		DLOG("InitOsakanaFpFft error");
-		return 1;
+	for (int i = 0; i < PITCH_PLAN_NUM; i++) {
+		if (InitOsakanaFpFft(&_fft[i], 1 << kPlanLog2N[i], kPlanLog2N[i]) != 0) {
+			DLOG("InitOsakanaFpFft error");
+			return 1;
+		}
 	}
 	_func = (ReadFpDataFunc_t)readFunc;
 
@@ -83,9 +197,11 @@ int PitchDetectorFp::Initialize(void* readFunc)
 
 void PitchDetectorFp::Cleanup()
 {
-	CleanOsakanaFpFft(_fft);
+	for (int i = 0; i < PITCH_PLAN_NUM; i++) {
+		CleanOsakanaFpFft(_fft[i]);
+		_fft[i] = NULL;
+	}
 	DestroyPeakDetectMachineContextFp(_det);
-	_fft = NULL;
 	_det = NULL;
 }
 
@@ -94,9 +210,20 @@ int PitchDetectorFp::DetectPitch(PitchInfo_t* pitchInfo)
 	int ret = 1;
 	ResetMachineFp(_det);
 
+	const uint8_t plan = SelectPlan();
+	const OsakanaFpFftContext_t* fft = _fft[plan];
+	const int log2n = kPlanLog2N[plan];
+	const int n = 1 << log2n;
+	const int n2 = n >> 1;
+	const int sc_pw = log2n - 7;			// SC_PW of this plan
+	const int sc_x2 = log2n * 2 - sc_pw;	// SC_X2 of this plan
+	// forget last pitch unless this frame finds it again
+	_lastLag = 0;
+	_lastClarity = 0;
+
 	// sampling from analog pin
 	DLOG("sampling...");
-	_func(&x[0].re, 2, N_ADC, &rawdata_min, &rawdata_max);
+	_func(&x[0].re, 2, n2, &rawdata_min, &rawdata_max);
 	DLOG("sampled");
 
 	DLOG("raw data --");
@@ -114,37 +241,37 @@ int PitchDetectorFp::DetectPitch(PitchInfo_t* pitchInfo)
 		}
 		pitchInfo->volume = rawdata_max - rawdata_min;
 
-		for (int i = 0; i < N2; i++) {
+		for (int i = 0; i < n2; i++) {
 			x[i].re = ScaleRawData(x[i].re, extraShift);
 			x[i].im = 0;
-			x[N2 + i].re = 0;
-			x[N2 + i].im = 0;
+			x[n2 + i].re = 0;
+			x[n2 + i].im = 0;
 			x2[i] = FpMul(x[i].re, x[i].re);
-			x2[i] = x2[i] >> SC_X2;
+			x2[i] = x2[i] >> sc_x2;
 		}
 	}
 	DLOG("normalized");
 
 	DLOG("-- normalized input signal");
-	DCOMPLEXFp(x, 256);
+	DCOMPLEXFp(x, n);
 
 	DLOG("-- fft/N");
-	OsakanaFpFft(_fft, x, 1); // 1 means scaling. (this x) = (nromal x) >> LOG2N
+	OsakanaFpFft(fft, x, 1); // 1 means scaling. (this x) = (nromal x) >> LOG2N
 	DCOMPLEXFp(x, DEBUG_OUTPUT_NUM);
 
 	DLOG("-- power spectrum");
-	for (int i = 0; i < N; i++) {
+	for (int i = 0; i < n; i++) {
 		//Fp_t re = FpMul(x[i].re, x[i].re) + 
 		//		  FpMul(x[i].im, x[i].im); // (this x) = (normal x) >> LOG2N*2
 		//x[i].re = (Fp_t)(re << (SC_PW)); // x = x >> (LOG2N*2-SC_PW)
 		FpW_t re = (FpW_t)x[i].re * (FpW_t)x[i].re + (FpW_t)x[i].im * (FpW_t)x[i].im;
-		x[i].re = (Fp_t)(re >> (FPSHFT - SC_PW));
+		x[i].re = (Fp_t)(re >> (FPSHFT - sc_pw));
 		x[i].im = 0;
 	}
 	DCOMPLEXFp(x, DEBUG_OUTPUT_NUM);
 
 	DLOG("-- IFFT");
-	OsakanaFpIfft(_fft, x, 1);// 1 means not *N scaling
+	OsakanaFpIfft(fft, x, 1);// 1 means not *N scaling
 	DCOMPLEXFp(x, DEBUG_OUTPUT_NUM);
 
 	// following loop compute :
@@ -161,7 +288,7 @@ int PitchDetectorFp::DetectPitch(PitchInfo_t* pitchInfo)
 	// curve analysis
 	InputFp(_det, _nsdf[0]);
 
-	for (int t = 1; t < N2; t++) {
+	for (int t = 1; t < n2; t++) {
 		//_m[t] = _m[t - 1] - x2[t - 1]
 		Fp_t m = m_old - x2_old;
 
@@ -184,36 +311,33 @@ int PitchDetectorFp::DetectPitch(PitchInfo_t* pitchInfo)
 	PeakInfoFp_t keyMaximums[4] = { 0 };
 	int keyMaxLen = 0;
 	GetKeyMaximumsFp(_det, FLOAT2FP(0.5f), keyMaximums, sizeof(keyMaximums) / sizeof(PeakInfoFp_t), &keyMaxLen);
-	if (0 < keyMaxLen) {
-		Fp_t delta = 0;
-		if (ParabolicInterpFp(_det, keyMaximums[0].index, _nsdf, N2, &delta)) {
-			//char printbuf[64] = { '\0' };
-			//Fp2CStr(delta, printbuf, sizeof(printbuf));
-			//printf("delta %s\n", printbuf);
-			//Fp2CStr(keyMaximums[0].value, debug_output_buf_, sizeof(debug_output_buf_));
-			//printf("nsdf=%s\n", debug_output_buf_);
-		}
+	if (keyMaxLen <= 0) {
+		PushLag(0);
+	}
+	else {
+		int sel = SelectKeyMaximum(keyMaximums, keyMaxLen);
+		PushLag(keyMaximums[sel].index);
+		sel = CorrectOctave(keyMaximums, keyMaxLen, sel);
 
 		// want freq = FREQ_PER_SAMPLE / (index+delta)
-		// idx1024=1024*index
-		int32_t idx1024 = keyMaximums[0].index << 10;
-		// int expression of 1024*delta
-		int32_t delta1024 = (delta >> (FPSHFT - 10));
-		idx1024 += delta1024;
-		// freq = freq_per_sample / idx
-		int32_t freq = (FREQ_PER_1024SAMPLE + (idx1024 >> 1)) / idx1024;
-
-		//int32_t idx = (idx1024 + 512) >> 10;
-		//uint8_t note = kNoteTable[idx] % 12;
-		int32_t idx8 = (idx1024 + 64) >> 7; // 64 is for rounding
-		uint8_t note = kNoteTable8[idx8] % 12;
+		int32_t idx1024 = InterpolatedLag1024(_det, &keyMaximums[sel], _nsdf, n2);
+		int32_t freq = Lag1024ToFreq(idx1024);
+
+		int16_t cents = 0;
+		uint8_t midiNote = NearestNote(Lag1024ToCents(idx1024), &cents);
 
 		pitchInfo->freq = (uint16_t)freq;
-		pitchInfo->midiNote = kNoteTable8[idx8];
-		pitchInfo->noteStr = kNoteStrings[note];
-		pitchInfo->pitch = GetAccuracy(pitchInfo->midiNote, idx8);
+		pitchInfo->midiNote = midiNote;
+		pitchInfo->noteStr = kNoteStrings[midiNote % 12];
+		pitchInfo->cents = cents;
+		pitchInfo->clarity = keyMaximums[sel].value;
+
+		_lastLag = keyMaximums[sel].index;
+		_lastClarity = keyMaximums[sel].value;
 
-		//PrintResult(freq, kNoteStrings[note], pitchInfo->pitch);
+		FillCandidates(_det, keyMaximums, keyMaxLen, _nsdf, n2, pitchInfo);
+
+		//PrintResult(freq, pitchInfo->noteStr, pitchInfo->cents);
 
 		ret = 0;
 	}
@@ -222,28 +346,105 @@ int PitchDetectorFp::DetectPitch(PitchInfo_t* pitchInfo)
 	return ret;
 }
 
-int8_t PitchDetectorFp::GetAccuracy(uint16_t note, uint16_t idx8)
+/**
+ *	pick smallest fft plan whose window holds at least 2 periods of last pitch.
+ *	fall back to largest plan when last pitch is unknown or unclear.
+ */
+uint8_t PitchDetectorFp::SelectPlan()
 {
-	if (_countof(kNoteTable8IndexRange) <= note) {
-		return INT8_MIN;
+	if (_lastLag == 0 || _lastClarity < PLAN_CLARITY_TH) {
+		return PITCH_PLAN_NUM - 1;
 	}
 
-	const NoteTableIndexRange_t* range = &kNoteTable8IndexRange[note];
-	uint16_t width = (range->max_idx - range->min_idx);
-	if (width < (uint16_t)4) {
-		return INT8_MIN;
+	for (uint8_t i = 0; i < PITCH_PLAN_NUM - 1; i++) {
+		uint16_t window = (uint16_t)1 << (kPlanLog2N[i] - 1);
+		if ((_lastLag << 1) <= window) {
+			return i;
+		}
 	}
+	return PITCH_PLAN_NUM - 1;
+}
 
-	uint16_t err = width / 6;
-	uint16_t mid = (range->max_idx + range->min_idx) >> 1;
-	if (idx8 < mid - err) {
-		// smaller index -> higher pitch
-		return (int8_t)(1);
+int PitchDetectorFp::SetTuning(uint16_t refFreq, uint8_t temperament, uint8_t tonic)
+{
+	if (refFreq < TUNING_REF_MIN || TUNING_REF_MAX < refFreq || kTemperamentNum <= temperament || 12 <= tonic) {
+		return 1;
+	}
+
+	// shift whole temperament so that A stays on refFreq
+	const int16_t* degrees = kTemperamentTable[temperament];
+	int32_t ref = Log2Cents(refFreq) - Log2Cents(TUNING_REF_DEFAULT) - degrees[(9 + 12 - tonic) % 12];
+	for (uint8_t i = 0; i < 12; i++) {
+		_noteCents[i] = (int16_t)(ref + degrees[(i + 12 - tonic) % 12]);
 	}
+	return 0;
+}
 
-	if (mid + err < idx8) {
-		// larger index -> lower pitch
-		return (int8_t)(-1);
+/**
+ *	midi note whose tuned pitch is closest to cents above midi note 0.
+ *	deviation from the note is returned in 1/16 cent
+ */
+uint8_t PitchDetectorFp::NearestNote(int32_t cents, int16_t* deviation)
+{
+	// equal tempered guess. reference and temperament shift targets by less than a semitone
+	int32_t guess = (cents + (50 << CENTS_SHFT)) / (100 << CENTS_SHFT);
+	int32_t best = 0;
+	int32_t bestDev = INT32_MAX;
+	for (int32_t note = max(guess - 1, (int32_t)0); note <= min(guess + 1, (int32_t)127); note++) {
+		int32_t dev = cents - (note * (100 << CENTS_SHFT) + _noteCents[note % 12]);
+		if (labs(dev) < labs(bestDev)) {
+			best = note;
+			bestDev = dev;
+		}
 	}
-	return (int8_t)(0);
+	*deviation = (int16_t)bestDev;
+	return (uint8_t)best;
+}
+
+/**
+ *	reject octave jump from recent lag when recent lag still has a strong key maximum
+ */
+int PitchDetectorFp::CorrectOctave(const PeakInfoFp_t* keyMaxs, int keyMaxLen, int sel)
+{
+	uint16_t ref = RecentLag();
+	if (ref == 0) {
+		return sel;
+	}
+
+	uint16_t lag = keyMaxs[sel].index;
+	if (!IsNearLag(lag, ref << 1) && !IsNearLag(lag << 1, ref)) {
+		return sel;
+	}
+
+	Fp_t th = FpMul(HISTORY_K, keyMaxs[0].value);
+	for (int i = 0; i < keyMaxLen; i++) {
+		if (th <= keyMaxs[i].value && IsNearLag(keyMaxs[i].index, ref)) {
+			DLOG("octave error %u -> %u", lag, keyMaxs[i].index);
+			return i;
+		}
+	}
+	return sel;
+}
+
+/**
+ *	median of lag history. single odd frame doesn't move it
+ */
+uint16_t PitchDetectorFp::RecentLag()
+{
+	uint16_t a = _lagHistory[0];
+	uint16_t b = _lagHistory[1];
+	uint16_t c = _lagHistory[2];
+	if (a > b) {
+		uint16_t t = a; a = b; b = t;
+	}
+	if (b > c) {
+		b = c;
+	}
+	return (a > b) ? a : b;
+}
+
+void PitchDetectorFp::PushLag(uint16_t lag)
+{
+	_lagHistory[_lagHistoryIdx] = lag;
+	_lagHistoryIdx = (_lagHistoryIdx + 1) % PITCH_HISTORY_LEN;
 }
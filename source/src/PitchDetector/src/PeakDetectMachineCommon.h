@@ -68,13 +68,6 @@ static const uint8_t kNoteTable[] = {
 };
 #endif
 
-// N=256
-// sampling rate = 0.07558072916669921875(GR-Kurumi with min, max)
-// x8 precision
-#include "NoteTable8.h"
-
-#include "NoteTable8IndexRange.h"
-
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -56,20 +56,31 @@ typedef struct _MachineContextFp_t {
 // Public
 /////////////////////////////////////////////////////////////////////
 
+// contexts are taken from static pool. no heap is used
+static MachineContextFp_t s_contextPool[PEAK_MACHINE_POOL_NUM];
+static bool s_contextUsed[PEAK_MACHINE_POOL_NUM];
+
 MachineContextFp_t* CreatePeakDetectMachineContextFp()
 {
-	MachineContextFp_t* ctx = (MachineContextFp_t*)malloc(sizeof(MachineContextFp_t));
-	if (ctx == NULL) {
-		return NULL;
+	for (int i = 0; i < PEAK_MACHINE_POOL_NUM; i++) {
+		if (!s_contextUsed[i]) {
+			s_contextUsed[i] = true;
+			MachineContextFp_t* ctx = &s_contextPool[i];
+			ResetMachineFp(ctx);
+			return ctx;
+		}
 	}
-	ResetMachineFp(ctx);
 
-	return ctx;
+	return NULL;
 }
 
 void DestroyPeakDetectMachineContextFp(MachineContextFp_t* ctx)
 {
-	free(ctx);
+	for (int i = 0; i < PEAK_MACHINE_POOL_NUM; i++) {
+		if (ctx == &s_contextPool[i]) {
+			s_contextUsed[i] = false;
+		}
+	}
 }
 
 void InputFp(MachineContextFp_t* ctx, Fp_t x)
@@ -100,21 +111,20 @@ void GetKeyMaximumsFp(MachineContextFp_t* ctx, Fp_t filter, PeakInfoFp_t* list,
 		return;
 	}
 
-	// threshold
-	Fp_t th = filter;
-	// elem num above threshold
-	int counter = 1;
-
-	if (ctx->globalKeyMax.value < th) {
-		counter = 0;
+	// global max must be above filter, others must be above filter * global max
+	if (ctx->globalKeyMax.value < filter) {
+		*num = 0;
 		return;
 	}
+	Fp_t th = FpMul(filter, ctx->globalKeyMax.value);
+	// elem num above threshold
+	int counter = 1;
 
-	// [0] is reserved for globalMax
+	// [0] is reserved for globalMax. the rest are in ascending lag
 	list[0] = ctx->globalKeyMax;
 	for (int i = 0; i < ctx->keyMaxsNum && counter < listmaxlen; i++) {
 		Fp_t keyMax = ctx->keyMaxs[i].value;
-		if (filter * keyMax < th) {
+		if (keyMax < th) {
 			continue;
 		}
 
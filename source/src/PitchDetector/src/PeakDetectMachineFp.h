@@ -4,6 +4,9 @@
 #include "PeakDetectMachineCommon.h"
 #include "OsakanaFp.h"
 
+// contexts available at once. one per PitchDetectorFp
+#define PEAK_MACHINE_POOL_NUM	1
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
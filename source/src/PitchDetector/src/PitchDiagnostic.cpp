@@ -1,7 +1,8 @@
 #include "PitchDiagnostic.h"
+#include "OsakanaPitchDetectionCommon.h"
 
-PitchDiagnostic::PitchDiagnostic(uint16_t interval)
-	: kInterval(interval)
+PitchDiagnostic::PitchDiagnostic(uint16_t interval, int16_t tolerance)
+	: kInterval(interval), kTolerance(tolerance)
 {
 	Reset();
 }
@@ -11,14 +12,9 @@ PitchDiagnostic::~PitchDiagnostic()
 {
 }
 
-DiagnoseResult_t PitchDiagnostic::Diagnose(int8_t pitch, uint8_t note)
+DiagnoseResult_t PitchDiagnostic::Diagnose(int16_t cents, uint8_t note)
 {
-	if (pitch == INT8_MIN) {
-		Reset();
-		return kDiagnoseResultNone;
-	}
-
-	return (this->*_func)(pitch, note);
+	return (this->*_func)(cents, note);
 }
 
 void PitchDiagnostic::Reset()
@@ -29,7 +25,7 @@ void PitchDiagnostic::Reset()
 	_note = 0;
 }
 
-DiagnoseResult_t PitchDiagnostic::diagnoseNoteOnState(int8_t pitch, uint8_t note)
+DiagnoseResult_t PitchDiagnostic::diagnoseNoteOnState(int16_t cents, uint8_t note)
 {
 	if (note == 0) {
 		Reset();
@@ -41,43 +37,38 @@ DiagnoseResult_t PitchDiagnostic::diagnoseNoteOnState(int8_t pitch, uint8_t note
 		return kDiagnoseResultNone;
 	}
 
-	if (pitch == INT8_MIN) {
-		Reset();
+	if (cents == CENTS_UNKNOWN) {
+		// a dropped frame doesn't break the note. just skip it
 		return kDiagnoseResultNone;
 	}
 
-	_sum += pitch;
+	_sum += cents;
 	_interval++;
 	if (kInterval <= _interval) {
-		int kIntervalHalf = (int)(kInterval >> 1);
+		int32_t average = _sum / (int32_t)_interval;
 		DiagnoseResult_t ret = kDiagnoseResultGood;
-		if (kIntervalHalf < _sum) {
+		if (kTolerance < average) {
 			ret = kDiagnoseResultHigh;
 		}
-		else if (_sum < -kIntervalHalf) {
+		else if (average < -kTolerance) {
 			ret = kDiagnoseResultLow;
 		}
-		// reset only interval. everthing else stay the same
+		// start next interval on the same note
 		_interval = 0;
+		_sum = 0;
 		return ret;
 	}
 
 	return kDiagnoseResultNone;
 }
 
-DiagnoseResult_t PitchDiagnostic::diagnoseNoteOffState(int8_t pitch, uint8_t note)
+DiagnoseResult_t PitchDiagnostic::diagnoseNoteOffState(int16_t cents, uint8_t note)
 {
 	if (note != 0) {
-		if (note == INT8_MIN) {
-			return kDiagnoseResultNone;
-		}
-
-		_sum = pitch;
 		_func = &PitchDiagnostic::diagnoseNoteOnState;
-		_interval++;
 		_note = note;
+		return diagnoseNoteOnState(cents, note);
 	}
 
 	return kDiagnoseResultNone;
 }
-
@@ -0,0 +1,77 @@
+#include "SilenceGate.h"
+
+static uint16_t ISqrt32(uint32_t val)
+{
+	uint32_t res = 0;
+	uint32_t one = 1UL << 30;
+
+	while (one > val) {
+		one >>= 2;
+	}
+
+	while (one != 0) {
+		if (val >= res + one) {
+			val -= res + one;
+			res += one << 1;
+		}
+		res >>= 1;
+		one >>= 2;
+	}
+	return (uint16_t)res;
+}
+
+SilenceGate::SilenceGate(uint16_t off2OnRms, uint16_t on2OffRms)
+	:
+	_sum(0),
+	_sumSq(0),
+	_num(0),
+	_rms(0),
+	_isOpen(false),
+	_vc(off2OnRms, on2OffRms)
+{
+}
+
+SilenceGate::~SilenceGate()
+{
+}
+
+void SilenceGate::Begin()
+{
+	_sum = 0;
+	_sumSq = 0;
+	_num = 0;
+}
+
+bool SilenceGate::End()
+{
+	if (_num == 0) {
+		return _isOpen;
+	}
+
+	// variance = E[x^2] - E[x]^2. removes dc offset of the mic bias
+	int32_t mean = _sum / (int32_t)_num;
+	uint32_t meanSq = _sumSq / _num;
+	uint32_t dc = (uint32_t)(mean * mean);
+	uint32_t var = (dc < meanSq) ? (meanSq - dc) : 0;
+
+	_rms = ISqrt32(var);
+	_isOpen = _vc.Input(_rms);
+	return _isOpen;
+}
+
+bool SilenceGate::IsOpen()
+{
+	return _isOpen;
+}
+
+uint16_t SilenceGate::Rms()
+{
+	return _rms;
+}
+
+void SilenceGate::Reset()
+{
+	Begin();
+	_rms = 0;
+	_isOpen = _vc.Input(0);
+}
@@ -0,0 +1,14 @@
+#ifndef _TEMPERAMENTTABLE_H_
+#define _TEMPERAMENTTABLE_H_
+
+// deviation from equal temperament of each degree above tonic in 1/16 cent
+static const int16_t kTemperamentTable[kTemperamentNum][12] = {
+	// equal
+	{    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0 },
+	// 5-limit just: 1 16/15 9/8 6/5 5/4 4/3 45/32 3/2 8/5 5/3 9/5 15/8
+	{    0,  188,   63,  250, -219,  -31, -156,   31,  219, -250,  282, -188 },
+	// pythagorean: 1 256/243 9/8 32/27 81/64 4/3 729/512 3/2 128/81 27/16 16/9 243/128
+	{    0, -156,   63,  -94,  125,  -31,  188,   31, -125,   94,  -63,  156 },
+};
+
+#endif
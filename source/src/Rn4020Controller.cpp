@@ -24,37 +24,60 @@
 #define CHAR_CMD_TEMPLATE       "CHW,001B,"
 
 typedef void (Rn4020Controller::*SendFunc_t)(const SerialCommand_t* pCmd);
-typedef bool (Rn4020Controller::*ResultTestFunc_t)();
+typedef int8_t (Rn4020Controller::*LineFunc_t)(const StrView_t* line);
 
 typedef struct _SerialCommand {
 	const char* cmd;
 	const int cmd_len;
 	const SendFunc_t send_func;
-	const ResultTestFunc_t test_func;
-	const int timeout;
-	const int try_num;
-	const int retry_sleep;
+	const LineFunc_t line_func;		// judges each received line
+	const uint16_t timeout;			// ms to wait for the result
+	const uint8_t try_num;
+	const uint16_t retry_sleep;
+	const char* abort_cmd;			// sent when a try failed
 } SerialCommand_t;
 
-static const int    kCmdRetry   = 3;
-static const char*  kOk         = "AOK";
-static const char*  kErr        = "ERR";
-static const char*  kReboot     = "Reboot";
+// result of a line
+static const int8_t kStepPending    = 0;
+static const int8_t kStepDone       = 1;
+static const int8_t kStepFailed     = -1;
+
+// state of current step
+static const uint8_t kStateSend     = 0;
+static const uint8_t kStateWait     = 1;
+static const uint8_t kStateSleep    = 2;
+
+static const char*  kOk             = "AOK";
+static const char*  kErr            = "ERR";
+static const char*  kConnectionEnd  = "Connection End";
 
 const SerialCommand_t Rn4020Controller::kInitCommands[]  = {
-	{CMD_FACTORY_RESET,		_strlen(CMD_FACTORY_RESET),		&Rn4020Controller::sendCmd,          &Rn4020Controller::testAOK, 100, 1, 0},
-	{CMD_FUNCTIONS,			_strlen(CMD_FUNCTIONS),			&Rn4020Controller::sendCmd,          &Rn4020Controller::testAOK, 100, 1, 0},
-	{CMD_REBOOT,			_strlen(CMD_REBOOT),			&Rn4020Controller::sendCmd,          &Rn4020Controller::testReboot, 1000,1, 0},
-	{CMD_STARTSCAN,		    _strlen(CMD_STARTSCAN),		    &Rn4020Controller::sendCmd,          &Rn4020Controller::testScanResult, 100, 10, 5000},
-	{CMD_STOPSCAN,	        _strlen(CMD_STOPSCAN),	        &Rn4020Controller::sendCmd,          &Rn4020Controller::testAOK, 100, 1, 0},
-	{CMD_CONNECT,		    _strlen(CMD_CONNECT),		    &Rn4020Controller::sendConnectCmd,   &Rn4020Controller::testConnectResult, 100, 1, 0},
-	{CMD_BONDING,		    _strlen(CMD_BONDING),		    &Rn4020Controller::sendCmd,          &Rn4020Controller::testBondResult, 100, 1, 0},
-	{CMD_LISTSERVICES,	    _strlen(CMD_LISTSERVICES),	    &Rn4020Controller::sendCmd,          &Rn4020Controller::testServiceListResult, 100, 1, 0},
+	{CMD_FACTORY_RESET,		_strlen(CMD_FACTORY_RESET),		&Rn4020Controller::sendCmd,          &Rn4020Controller::lineAOK,         2000, 1, 1000, NULL},
+	{CMD_FUNCTIONS,			_strlen(CMD_FUNCTIONS),			&Rn4020Controller::sendCmd,          &Rn4020Controller::lineAOK,         2000, 1, 0, NULL},
+	{CMD_REBOOT,			_strlen(CMD_REBOOT),			&Rn4020Controller::sendCmd,          &Rn4020Controller::lineReboot,      5000, 1, 0, NULL},
+	{CMD_STARTSCAN,		    _strlen(CMD_STARTSCAN),		    &Rn4020Controller::sendCmd,          &Rn4020Controller::lineScanResult,  5000, 10, 5000, CMD_STOPSCAN},
+	{CMD_STOPSCAN,	        _strlen(CMD_STOPSCAN),	        &Rn4020Controller::sendCmd,          &Rn4020Controller::lineAOK,         2000, 1, 0, NULL},
+	{CMD_CONNECT,		    _strlen(CMD_CONNECT),		    &Rn4020Controller::sendConnectCmd,   &Rn4020Controller::lineConnectResult, 10000, 1, 0, NULL},
+	{CMD_BONDING,		    _strlen(CMD_BONDING),		    &Rn4020Controller::sendCmd,          &Rn4020Controller::lineBondResult,  10000, 1, 0, NULL},
+	{CMD_LISTSERVICES,	    _strlen(CMD_LISTSERVICES),	    &Rn4020Controller::sendCmd,          &Rn4020Controller::lineServiceListResult, 3000, 1, 0, NULL},
 };
 
-Rn4020Controller::Rn4020Controller(HardwareSerial& serial)
+// reconnection starts from scan. module is already configured
+static const uint8_t kStepScan = 3;
+// step after all of kInitCommands
+#define kStepConnected  _countof(kInitCommands)
+
+Rn4020Controller::Rn4020Controller(Stream& serial)
 :
-_serial(serial)
+_serial(serial),
+m_step(0),
+m_stepState(kStateSend),
+m_tryNum(0),
+m_stepTime(0),
+m_pendingHead(0),
+m_pendingNum(0),
+m_errorFunc(NULL),
+m_errorContext(NULL)
 {
     memset(m_charHandle, 0, sizeof(m_charHandle));
     memset(m_macAddress, 0, sizeof(m_macAddress));
@@ -66,67 +89,211 @@ Rn4020Controller::~Rn4020Controller()
 {
 }
 
+/**
+ *  start connection sequence. it goes on in Yield()
+ */
 bool Rn4020Controller::Initialize()
 {
-    bool result = false;
-	
-	for(int i = 0; i < _countof(kInitCommands); i++) {
-		_serial.Purge();
-		
-		const SerialCommand_t* pCmd = &kInitCommands[i];
-		_serial.SetTimeout(pCmd->timeout);
-		
-		const char* cmd = pCmd->cmd;
-		for(int try_num = 0; try_num < pCmd->try_num; try_num++) {
-		
-			_serial.Purge();
-			
-			const SendFunc_t sendfunc = pCmd->send_func;
-    		(this->*sendfunc)(pCmd);
-    		
-    		const ResultTestFunc_t func = pCmd->test_func;
-    		if((this->*func)()) {
-    		    result = true;
-    		    break;
-    		}
-    		delay(pCmd->retry_sleep);
-		}
-		
-		if(!result) {
-		    // return to go over init sequence
-		    return false;
-		}
-	}
-	
-	strncpy(&m_charCmdBuf[4], m_charHandle, 4);
-	
-	return result;
+	_serial.Purge();
+	startStep(0);
+	return true;
+}
+
+bool Rn4020Controller::IsConnected()
+{
+	return m_step == kStepConnected;
 }
 
+/**
+ *  data is in hex
+ */
 bool Rn4020Controller::WriteCharacteristic(const char* data, int len)
 {
-    char cmd[36] = {'0'};
-    strncpy(cmd, CHAR_CMD_TEMPLATE, sizeof(cmd));
-    strncpy(&cmd[4], m_charHandle, 4);
-    int cpylen = min(32-9-1, len);
-    strncpy(&cmd[9], data, cpylen);
-    cmd[9+cpylen+1] = '\0';
+    if(!IsConnected()) {
+        return false;
+    }
+    int cpylen = min(RN4020_CHAR_MAX * 2, len);
+    strncpy(&m_charCmdBuf[9], data, cpylen);
+    m_charCmdBuf[9 + cpylen] = '\0';
+    
+    return sendPipelined(m_charCmdBuf);
+}
+
+bool Rn4020Controller::WriteCharacteristic(const uint8_t* data, uint8_t len)
+{
+    if(!IsConnected()) {
+        return false;
+    }
+    uint8_t cpylen = min(RN4020_CHAR_MAX, (int)len);
+    char* hex = &m_charCmdBuf[9];
+    for(uint8_t i = 0; i < cpylen; i++) {
+        hexUi8(data[i], hex);
+        hex += 2;
+    }
+    *hex = '\0';
     
-    return sendWithAck(cmd);
+    return sendPipelined(m_charCmdBuf);
 }
 
+/**
+ *  @return kRn4020EvtConnected or kRn4020EvtDisconnected when connection state changed
+ */
 uint32_t Rn4020Controller::Yield()
 {
-    _serial.Purge();
-    return 0;
+    bool wasConnected = IsConnected();
+    
+    serviceLines();
+    if(IsConnected()) {
+        expirePending();
+    } else {
+        stepConnection(NULL);
+    }
+    
+    if(!wasConnected && IsConnected()) {
+        return kRn4020EvtConnected;
+    }
+    if(wasConnected && !IsConnected()) {
+        return kRn4020EvtDisconnected;
+    }
+    return kRn4020EvtNone;
+}
+
+void Rn4020Controller::SetErrorCallback(Rn4020ErrorFunc_t func, void* context)
+{
+    m_errorFunc = func;
+    m_errorContext = context;
 }
 
-const char* Rn4020Controller::sendWithAck(const char* data)
+/**
+ *  send without waiting for AOK of previous writes.
+ *  blocks only while RN4020_INFLIGHT_MAX writes are pending
+ */
+bool Rn4020Controller::sendPipelined(const char* data)
 {
+    serviceLines();
+    expirePending();
+    while(m_pendingNum == RN4020_INFLIGHT_MAX && IsConnected()) {
+        // oldest one is acked or timed out at last
+        serviceLines();
+        expirePending();
+    }
+    if(!IsConnected()) {
+        return false;
+    }
+    
     DEBUG(data);
-     _serial.PrintLn(data);
-    const char* resp_word[] = { kOk, kErr };
-    _serial.WaitForOneOfWords(resp_word, _countof(resp_word), 5, 1);
+    _serial.PrintLn(data);
+    m_pendingSent[(m_pendingHead + m_pendingNum) % RN4020_INFLIGHT_MAX] = millis();
+    m_pendingNum++;
+    return true;
+}
+
+/**
+ *  dispatch received lines. AOK/ERR go to pending writes in order while connected,
+ *  others to current step of connection sequence
+ */
+void Rn4020Controller::serviceLines()
+{
+    StrView_t line;
+    while(_serial.PollLine(&line)) {
+        if(viewStartsWith(&line, kConnectionEnd)) {
+            LOG("connection end");
+            startStep(kStepScan);
+        } else if(IsConnected()) {
+            if(m_pendingNum == 0) {
+                continue;
+            }
+            if(viewStartsWith(&line, kOk)) {
+                popPending(0);
+            } else if(viewStartsWith(&line, kErr)) {
+                popPending(kRn4020ErrNak);
+            }
+        } else if(m_stepState == kStateWait) {
+            stepConnection(&line);
+        }
+    }
+}
+
+void Rn4020Controller::expirePending()
+{
+    uint32_t now = millis();
+    while(m_pendingNum != 0 && RN4020_ACK_TIMEOUT_MS < now - m_pendingSent[m_pendingHead]) {
+        popPending(kRn4020ErrTimeout);
+    }
+}
+
+void Rn4020Controller::startStep(uint8_t step)
+{
+    m_step = step;
+    m_stepState = kStateSend;
+    m_tryNum = 0;
+    m_pendingHead = 0;
+    m_pendingNum = 0;
+    if(step <= kStepScan) {
+        memset(m_charHandle, 0, sizeof(m_charHandle));
+    }
+}
+
+/**
+ *  advance connection sequence by a received line, or by time if line is NULL
+ */
+void Rn4020Controller::stepConnection(const StrView_t* line)
+{
+    const SerialCommand_t* pCmd = &kInitCommands[m_step];
+    uint32_t now = millis();
+    
+    switch(m_stepState) {
+        case kStateSend:
+            (this->*(pCmd->send_func))(pCmd);
+            m_stepState = kStateWait;
+            m_stepTime = now;
+            break;
+        case kStateWait: {
+            int8_t result = kStepPending;
+            if(line != NULL) {
+                result = (this->*(pCmd->line_func))(line);
+            } else if(pCmd->timeout < now - m_stepTime) {
+                LOG("step timeout");
+                result = kStepFailed;
+            }
+            
+            if(result == kStepDone) {
+                if(m_step + 1 == kStepConnected) {
+                    memcpy(&m_charCmdBuf[4], m_charHandle, 4);
+                    LOG("connected");
+                }
+                startStep(m_step + 1);
+            } else if(result == kStepFailed) {
+                if(pCmd->abort_cmd != NULL) {
+                    _serial.PrintLn(pCmd->abort_cmd);
+                }
+                if(++m_tryNum < pCmd->try_num) {
+                    m_stepState = kStateSleep;
+                } else {
+                    // go over init sequence
+                    startStep(0);
+                    m_stepState = kStateSleep;
+                }
+                m_stepTime = now;
+            }
+            break;
+        }
+        case kStateSleep:
+        default:
+            if(pCmd->retry_sleep <= now - m_stepTime) {
+                m_stepState = kStateSend;
+            }
+            break;
+    }
+}
+
+void Rn4020Controller::popPending(uint8_t error)
+{
+    m_pendingHead = (m_pendingHead + 1) % RN4020_INFLIGHT_MAX;
+    m_pendingNum--;
+    if(error != 0 && m_errorFunc != NULL) {
+        m_errorFunc(m_errorContext, error);
+    }
 }
 
 void Rn4020Controller::send(const char* data)
@@ -134,66 +301,46 @@ void Rn4020Controller::send(const char* data)
     _serial.PrintLn(data);
 }
 
-bool Rn4020Controller::parseScanResult(const char* str, char (&mac)[13], char (&pub)[2], char (&dev)[32], char (&uuid)[33])
+/**
+ *  mac, public, device name, uuid, rssi
+ */
+bool Rn4020Controller::parseScanResult(const StrView_t* line, StrView_t* mac, StrView_t* pub, StrView_t* uuid)
 {
-	if (strlen(str) < sizeof(mac) + sizeof(pub) + 1 + sizeof(uuid)) {
-		return false;
-	}
-
-	int pos = 0;
-	copyCommaSeparatedWord(str + pos, mac, sizeof(mac));
-	if (strlen(mac) != 12) {
+	StrView_t words[5];
+	if (splitCommaSeparated(line->str, line->len, words, _countof(words)) < 4) {
 		return false;
 	}
-	pos += strlen(mac) + 1;
-	copyCommaSeparatedWord(str + pos, pub, sizeof(pub));
-	if (strlen(pub) != 1) {
-		return false;
-	}
-	pos += strlen(pub) + 1;
-	copyCommaSeparatedWord(str + pos, dev, sizeof(dev));
-	pos += strlen(dev) + 1;
-	copyCommaSeparatedWord(str + pos, uuid, sizeof(uuid));
-	if (strlen(uuid) != 32) {
+	if (words[0].len != 12 || words[1].len != 1 || words[3].len != 32) {
 		return false;
 	}
+	*mac = words[0];
+	*pub = words[1];
+	*uuid = words[3];
 	return true;
 }
 
-bool Rn4020Controller::parseServiceListResult(const char* str, const char* uuid, char(&handle)[5])
+/**
+ *  2 spaces, uuid, handle, property
+ */
+bool Rn4020Controller::parseServiceListResult(const StrView_t* line, const char* uuid, char(&handle)[5])
 {
-	if (strlen(str) < 2 + 40) {
+	if (line->len < 2 + 40 || line->str[0] != ' ' || line->str[1] != ' ') {
 		return false;
 	}
 
-	if (str[0] != ' ' || str[1] != ' ') {
+	StrView_t words[3];
+	if (splitCommaSeparated(line->str + 2, line->len - 2, words, _countof(words)) != 3) {
 		return false;
 	}
-
-	int pos = 2;
-	char theUuid[33] = { 0 };
-	copyCommaSeparatedWord(str + pos, theUuid, sizeof(theUuid));
-	if (strcmp(theUuid, uuid) != 0) {
-		return false;
-	}
-
-	pos += strlen(uuid) + 1;
-	copyCommaSeparatedWord(str + pos, handle, sizeof(handle));
-	if (strlen(handle) != 4) {
-		return false;
-	}
-
-	pos += strlen(handle) + 1;
-	char prop[3] = { 0 };
-	copyCommaSeparatedWord(str + pos, prop, sizeof(prop));
-	if (strlen(prop) != 2) {
+	if (!viewEquals(&words[0], uuid) || words[1].len != 4) {
 		return false;
 	}
 	// better to check bit flag
-	if (strcmp(prop, "0E") != 0) {
+	if (!viewEquals(&words[2], "0E")) {
 		return false;
 	}
 	
+	copyView(&words[1], handle, sizeof(handle));
 	return true;
 }
 
@@ -210,69 +357,61 @@ void Rn4020Controller::sendConnectCmd(const SerialCommand_t* pCmd)
     buf[1] = ',';
     buf[2] = m_public[0];
     buf[3] = ',';
-    strncpy(buf+4, m_macAddress, 12);
+    memcpy(buf+4, m_macAddress, 12);
     LOG(buf);
 	_serial.PrintLn(buf);
 }
 
-bool Rn4020Controller::testAOK()
+int8_t Rn4020Controller::lineAOK(const StrView_t* line)
 {
-    return _serial.WaitForWord(kOk, 1000, 8);
+    if(viewStartsWith(line, kOk)) {
+        return kStepDone;
+    }
+    if(viewStartsWith(line, kErr)) {
+        return kStepFailed;
+    }
+    return kStepPending;
 }
 
-bool Rn4020Controller::testReboot()
+/**
+ *  Reboot then CMD
+ */
+int8_t Rn4020Controller::lineReboot(const StrView_t* line)
 {
-    _serial.WaitForWord("Reboot", 1000, 16);
-    _serial.WaitForWord("CMD", 1000, 16);
+    return viewStartsWith(line, "CMD") ? kStepDone : kStepPending;
 }
-    
+
 /**
- *  connect command takes sometime. so we need special func
+ *  connect command takes sometime
  */
-bool Rn4020Controller::testConnectResult()
+int8_t Rn4020Controller::lineConnectResult(const StrView_t* line)
 {
-    return _serial.WaitForWord("Connected", 1000, 16);
+    return viewStartsWith(line, "Connected") ? kStepDone : kStepPending;
 }
 
 /**
- * test result is something like this
+ * result is something like this
  *  E47118C2BED1,1,UD-BT01,03B80E5AEDE84B33A7516CE34EC4C700,-41
  */
-bool Rn4020Controller::testScanResult()
+int8_t Rn4020Controller::lineScanResult(const StrView_t* line)
 {
-    char buf[64] = {0};
-    bool result = false;
-    // assuming num of services are less than 32
-    for(int i = 0; i < 32; i++)
-    {
-        _serial.ReadLine(buf, sizeof(buf));
-        
-		char mac[13] = { 0 };
-		char pub[2] = { 0 };
-		char dev[32] = { 0 };
-		char uuid[33] = { 0 };
-
-		if (parseScanResult(buf, mac, pub, dev, uuid)) {
-			if(strcmp(uuid, UUID_CHAR) != 0) {
-		        result = true;
-		        strcpy(m_macAddress, mac);
-		        strcpy(m_public, pub);
-		        LOG("uuid matched");
-		        break;
-		    }
-		}
-    }
-
-    if(!result) {
-        // stop scan and prepare for retry
-        _serial.PrintLn(CMD_STOPSCAN);
-    }
-
-	return result;
+	StrView_t mac;
+	StrView_t pub;
+	StrView_t uuid;
+	if (!parseScanResult(line, &mac, &pub, &uuid)) {
+		return kStepPending;
+	}
+	if (viewEquals(&uuid, UUID_CHAR)) {
+		return kStepPending;
+	}
+	copyView(&mac, m_macAddress, sizeof(m_macAddress));
+	copyView(&pub, m_public, sizeof(m_public));
+	LOG("uuid matched");
+	return kStepDone;
 }
 
 /**
- * test result is something like this
+ * result is something like this
 LC
 180A
   2A29,000E,02
@@ -286,30 +425,18 @@ LC
   7772E5DB38684112A1A9F2669D106BF3,001C,10
 END
  */
-bool Rn4020Controller::testServiceListResult()
+int8_t Rn4020Controller::lineServiceListResult(const StrView_t* line)
 {
-    char buf[64] = {0};
-    bool result = false;
-    // assuming 32 lines received
-    for(int i = 0; i < 32; i++)
-    {
-        _serial.ReadLine(buf, sizeof(buf));
-        
-		if (parseServiceListResult(buf, UUID_CHAR, m_charHandle)) {
-		    result = true;
-		    LOG("char handle obtained");
-			break;
-		}
-    }
-
-    _serial.WaitForWord("END", 1000, 16);
-    
-	return result;
+	if (viewStartsWith(line, "END")) {
+		return (m_charHandle[0] != '\0') ? kStepDone : kStepFailed;
+	}
+	if (parseServiceListResult(line, UUID_CHAR, m_charHandle)) {
+	    LOG("char handle obtained");
+	}
+	return kStepPending;
 }
 
-bool Rn4020Controller::testBondResult()
+int8_t Rn4020Controller::lineBondResult(const StrView_t* line)
 {
-    return _serial.WaitForWord("Bonded", 1000, 16);
+    return viewStartsWith(line, "Bonded") ? kStepDone : kStepPending;
 }
-
-
@@ -3,41 +3,79 @@
 
 #include "SerialController.h"
 
-class HardwareSerial;
+#define RN4020_CHAR_MAX     20  // bytes written to a characteristic at once
+#define RN4020_CHAR_CMD_LEN (9 + RN4020_CHAR_MAX * 2)   // CHW,hhhh, + hex
+
+#define RN4020_INFLIGHT_MAX     4       // writes sent before their AOK
+#define RN4020_ACK_TIMEOUT_MS   200
+
+#define kRn4020ErrNak       1   // ERR received
+#define kRn4020ErrTimeout   2   // no response in RN4020_ACK_TIMEOUT_MS
+
+// returned by Yield()
+#define kRn4020EvtNone          0
+#define kRn4020EvtConnected     1
+#define kRn4020EvtDisconnected  2
+
+typedef void (*Rn4020ErrorFunc_t)(void* context, uint8_t error);
+
+class Stream;
 typedef struct _SerialCommand SerialCommand_t;
 
 class Rn4020Controller
 {
 public:
-	Rn4020Controller(HardwareSerial& serial);
+	Rn4020Controller(Stream& serial);
 	~Rn4020Controller();
 	
 	bool Initialize();
+	bool IsConnected();
 	bool WriteCharacteristic(const char* data, int len);
+	bool WriteCharacteristic(const uint8_t* data, uint8_t len);
 	uint32_t Yield();
+	/**
+	 *  func is called from Yield() or WriteCharacteristic() for a write which failed
+	 */
+	void SetErrorCallback(Rn4020ErrorFunc_t func, void* context);
 	
 	void sendCmd(const SerialCommand_t* pCmd);
 	void sendConnectCmd(const SerialCommand_t* pCmd);
 	
-	bool testAOK();
-	bool testReboot();
-	bool testConnectResult();
-	bool testScanResult();
-	bool testServiceListResult();
-	bool testBondResult();
+	int8_t lineAOK(const StrView_t* line);
+	int8_t lineReboot(const StrView_t* line);
+	int8_t lineConnectResult(const StrView_t* line);
+	int8_t lineScanResult(const StrView_t* line);
+	int8_t lineServiceListResult(const StrView_t* line);
+	int8_t lineBondResult(const StrView_t* line);
 	
 private:
 	SerialController _serial;
 	static const SerialCommand_t kInitCommands[];
-    char m_public[0];
+	// connection sequence stepped from Yield()
+	uint8_t m_step;             // index of kInitCommands. connected after the last one
+	uint8_t m_stepState;
+	uint8_t m_tryNum;
+	uint32_t m_stepTime;        // millis when state started
+    char m_public[2];
     char m_charHandle[5];
     char m_macAddress[13];
-    char m_charCmdBuf[32];
+    char m_charCmdBuf[RN4020_CHAR_CMD_LEN + 1];
+    // writes waiting for AOK. responses come in order of writes
+    uint32_t m_pendingSent[RN4020_INFLIGHT_MAX];   // millis when sent
+    uint8_t m_pendingHead;
+    uint8_t m_pendingNum;
+    Rn4020ErrorFunc_t m_errorFunc;
+    void* m_errorContext;
     
-	const char* sendWithAck(const char* data);
+	bool sendPipelined(const char* data);
+	void serviceLines();
+	void expirePending();
+	void popPending(uint8_t error);
+	void startStep(uint8_t step);
+	void stepConnection(const StrView_t* line);
 	void send(const char* data);
-	bool parseScanResult(const char* str, char (&mac)[13], char (&pub)[2], char (&dev)[32], char (&uuid)[33]);
-    bool parseServiceListResult(const char* str, const char* uuid, char(&handle)[5]);
+	bool parseScanResult(const StrView_t* line, StrView_t* mac, StrView_t* pub, StrView_t* uuid);
+    bool parseServiceListResult(const StrView_t* line, const char* uuid, char(&handle)[5]);
 };
 
 #endif
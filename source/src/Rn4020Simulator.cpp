@@ -0,0 +1,236 @@
+#include "Rn4020Simulator.h"
+
+#if defined(USE_RN4020_SIMULATOR) || defined(HOST_BUILD)
+
+#include "StringUtility.h"
+#include "CommonTool.h"
+
+#define SIM_SCAN_DELAY      500     // ms until the peer is found
+#define SIM_CONNECT_DELAY   300
+#define SIM_REBOOT_DELAY    500
+
+static const char* kOk = "AOK";
+static const char* kErr = "ERR";
+
+static const char* kScanResult = "E47118C2BED1,1,SimPeer,03B80E5AEDE84B33A7516CE34EC4C700,-41";
+
+static const char* kServiceList[] = {
+    "180A",
+    "  2A29,000E,02",
+    "  2A24,0010,02",
+    "03B80E5AEDE84B33A7516CE34EC4C700",
+    "  7772E5DB38684112A1A9F2669D106BF3,001B,0E",
+    "  7772E5DB38684112A1A9F2669D106BF3,001C,10",
+    "END",
+};
+
+// services of BleCommunicator in peripheral role. value handles match its WV,001x
+static const char* kServerList[] = {
+    "180A",
+    "  2A29,000E,02",
+    "  2A24,0010,02",
+    "123456789012345678901234567890FF",
+    "  12345678901234567890123456789033,0018,12",
+    "  12345678901234567890123456789033,0019,10",
+    "  12345678901234567890123456789034,001B,06",
+    "  12345678901234567890123456789035,001D,06",
+    "  12345678901234567890123456789036,001F,08",
+    "  12345678901234567890123456789037,0021,10",   // stream
+    "  12345678901234567890123456789037,0022,10",   // and its configuration
+    "END",
+};
+static const uint8_t kServerStreamLine = 9;
+
+// commands only acknowledged
+static const char* kAckCommands[] = {
+    "SF,", "SR,", "SS,", "SN,", "S-,", "PZ", "PS,", "PC,", "SD", "X",
+};
+
+Rn4020Simulator Rn4020Sim;
+
+Rn4020Simulator::Rn4020Simulator()
+:
+_cmdLen(0),
+_lineHead(0),
+_lineNum(0),
+_linePos(0),
+_lastDue(0),
+_latency(10),
+_errorInterval(0),
+_dropInterval(0),
+_connected(false),
+_streamListed(true)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void Rn4020Simulator::Disconnect()
+{
+    _connected = false;
+    respond("Connection End", 0);
+}
+
+void Rn4020Simulator::PrintStats(Print& out)
+{
+    char buf[96];
+    uint16_t avg = (_stats.latencyNum == 0) ? 0 : (uint16_t)(_stats.latencySum / _stats.latencyNum);
+    snprintf(buf, sizeof(buf), "sim writes=%lu errors=%lu midi=%lu latency avg=%u max=%u",
+        (unsigned long)_stats.writes, (unsigned long)_stats.errors, (unsigned long)_stats.midiBytes, avg, _stats.latencyMax);
+    out.println(buf);
+}
+
+int Rn4020Simulator::available()
+{
+    if(!isHeadReady()) {
+        return 0;
+    }
+    return strlen(_lines[_lineHead].text) + 2 - _linePos;
+}
+
+int Rn4020Simulator::peek()
+{
+    if(!isHeadReady()) {
+        return -1;
+    }
+    const char* text = _lines[_lineHead].text;
+    uint8_t len = strlen(text);
+    if(_linePos < len) {
+        return text[_linePos];
+    }
+    return (_linePos == len) ? '\r' : '\n';
+}
+
+int Rn4020Simulator::read()
+{
+    int c = peek();
+    if(c < 0) {
+        return c;
+    }
+    _linePos++;
+    if(c == '\n') {
+        _lineHead = (_lineHead + 1) % RN4020_SIM_QUEUE_LEN;
+        _lineNum--;
+        _linePos = 0;
+    }
+    return c;
+}
+
+void Rn4020Simulator::flush()
+{
+}
+
+size_t Rn4020Simulator::write(uint8_t c)
+{
+    if(c == '\r') {
+        return 1;
+    }
+    if(c == '\n') {
+        _cmd[_cmdLen] = '\0';
+        handleCommand();
+        _cmdLen = 0;
+    } else if(_cmdLen < RN4020_SIM_LINE_MAX - 1) {
+        _cmd[_cmdLen++] = c;
+    }
+    return 1;
+}
+
+void Rn4020Simulator::handleCommand()
+{
+    if(strncmp(_cmd, "CHW,", 4) == 0 || strncmp(_cmd, "SUW,", 4) == 0 || strncmp(_cmd, "SHW,", 4) == 0) {
+        // payload follows handle or uuid
+        const char* payload = strchr(&_cmd[4], ',');
+        handleWrite(payload == NULL ? "" : payload + 1, _cmd[0] == 'C');
+    } else if(strncmp(_cmd, "R,", 2) == 0) {
+        _connected = false;
+        respond("Reboot", SIM_REBOOT_DELAY);
+        respond("CMD", 0);
+    } else if(strcmp(_cmd, "F") == 0) {
+        respond(kOk, 0);
+        respond(kScanResult, SIM_SCAN_DELAY);
+    } else if(strncmp(_cmd, "E,", 2) == 0) {
+        respond(kOk, 0);
+        respond("Connected", SIM_CONNECT_DELAY);
+        _connected = true;
+    } else if(strcmp(_cmd, "B") == 0) {
+        respond(kOk, 0);
+        respond("Bonded", 0);
+    } else if(strcmp(_cmd, "LC") == 0) {
+        for(uint8_t i = 0; i < _countof(kServiceList); i++) {
+            respond(kServiceList[i], 0);
+        }
+    } else if(strcmp(_cmd, "LS") == 0) {
+        for(uint8_t i = 0; i < _countof(kServerList); i++) {
+            if(!_streamListed && (i == kServerStreamLine || i == kServerStreamLine + 1)) {
+                continue;
+            }
+            respond(kServerList[i], 0);
+        }
+    } else {
+        for(uint8_t i = 0; i < _countof(kAckCommands); i++) {
+            if(strncmp(_cmd, kAckCommands[i], strlen(kAckCommands[i])) == 0) {
+                respond(kOk, 0);
+                return;
+            }
+        }
+        respond(kErr, 0);
+    }
+}
+
+void Rn4020Simulator::handleWrite(const char* payload, bool isMidi)
+{
+    _stats.writes++;
+    if(_dropInterval != 0 && _stats.writes % _dropInterval == 0) {
+        _stats.errors++;
+        return;
+    }
+    // server writes are taken without a peer. its notification is just not sent
+    if((isMidi && !_connected) || (_errorInterval != 0 && _stats.writes % _errorInterval == 0)) {
+        _stats.errors++;
+        respond(kErr, 0);
+        return;
+    }
+    
+    uint8_t len = strlen(payload) / 2;
+    if(isMidi && 2 <= len) {
+        // header and timestamp of first message carry 13 bit millis
+        char hex[5] = {0};
+        memcpy(hex, payload, 4);
+        uint16_t head = (uint16_t)strtoul(hex, NULL, 16);
+        uint16_t timestamp = ((head >> 1) & 0x1F80) | (head & 0x7F);
+        uint16_t latency = ((uint16_t)millis() - timestamp) & 0x1FFF;
+        _stats.midiBytes += len;
+        _stats.latencySum += latency;
+        _stats.latencyNum++;
+        if(_stats.latencyMax < latency) {
+            _stats.latencyMax = latency;
+        }
+    }
+    respond(kOk, 0);
+}
+
+/**
+ *  queue a line. lines are read in order, each after the latency and extra delay
+ */
+void Rn4020Simulator::respond(const char* text, uint16_t delay)
+{
+    if(_lineNum == RN4020_SIM_QUEUE_LEN) {
+        return;
+    }
+    uint32_t due = millis() + _latency + delay;
+    if((int32_t)(due - _lastDue) < 0) {
+        due = _lastDue;
+    }
+    _lastDue = due;
+    
+    Rn4020SimLine_t* line = &_lines[(_lineHead + _lineNum) % RN4020_SIM_QUEUE_LEN];
+    line->text = text;
+    line->due = due;
+    _lineNum++;
+}
+
+bool Rn4020Simulator::isHeadReady()
+{
+    return _lineNum != 0 && (int32_t)(millis() - _lines[_lineHead].due) >= 0;
+}
+
+#endif
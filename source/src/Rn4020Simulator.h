@@ -0,0 +1,92 @@
+#ifndef _RN4020SIMULATOR_H_
+#define _RN4020SIMULATOR_H_
+
+#include <Arduino.h>
+
+#define RN4020_SIM_LINE_MAX     80  // SUW with uuid and 19 bytes
+#define RN4020_SIM_QUEUE_LEN    16  // response lines waiting for their time
+
+typedef struct Rn4020SimStats_tag {
+    uint32_t writes;            // CHW, SUW and SHW received
+    uint32_t errors;            // ERR returned or response dropped
+    uint32_t midiBytes;         // BLE-MIDI payload bytes
+    uint32_t latencySum;        // ms from BLE-MIDI timestamp to CHW received
+    uint16_t latencyMax;
+    uint16_t latencyNum;
+} Rn4020SimStats_t;
+
+typedef struct Rn4020SimLine_tag {
+    const char* text;
+    uint32_t due;               // millis when the line can be read
+} Rn4020SimLine_t;
+
+/**
+ *  stands in for RN4020 on the serial port. commands written to it are answered
+ *  as the module in central role does, with a latency and injected errors.
+ *  services of BleCommunicator are listed by LS for peripheral role.
+ *  used with -DUSE_RN4020_SIMULATOR so that BLE code runs with no radio,
+ *  or attached to Serial1 of the host build(see host/Rn4020Bench.cpp).
+ */
+class Rn4020Simulator : public Stream
+{
+public:
+    Rn4020Simulator();
+    
+    void begin(unsigned long baud) {}
+    void SetLatency(uint16_t ms) { _latency = ms; }
+    /**
+     *  every n-th write is answered ERR or not answered. 0 disables
+     */
+    void SetErrorInterval(uint16_t n) { _errorInterval = n; }
+    void SetDropInterval(uint16_t n) { _dropInterval = n; }
+    /**
+     *  false leaves stream characteristic out of LS as firmware before it
+     */
+    void SetStreamListed(bool listed) { _streamListed = listed; }
+    /**
+     *  peer goes away. "Connection End" is sent
+     */
+    void Disconnect();
+    const Rn4020SimStats_t* Stats() { return &_stats; }
+    void PrintStats(Print& out);
+    
+    virtual int available();
+    virtual int read();
+    virtual int peek();
+    virtual void flush();
+    virtual size_t write(uint8_t c);
+    using Print::write;
+    
+private:
+    char _cmd[RN4020_SIM_LINE_MAX];
+    uint8_t _cmdLen;
+    Rn4020SimLine_t _lines[RN4020_SIM_QUEUE_LEN];
+    uint8_t _lineHead;
+    uint8_t _lineNum;
+    uint8_t _linePos;           // read position in head line. CR LF follow the text
+    uint32_t _lastDue;
+    uint16_t _latency;
+    uint16_t _errorInterval;
+    uint16_t _dropInterval;
+    bool _connected;
+    bool _streamListed;
+    Rn4020SimStats_t _stats;
+    
+    void handleCommand();
+    void handleWrite(const char* payload, bool isMidi);
+    void respond(const char* text, uint16_t delay);
+    bool isHeadReady();
+};
+
+#if defined(USE_RN4020_SIMULATOR) || defined(HOST_BUILD)
+extern Rn4020Simulator Rn4020Sim;
+#endif
+
+// host build keeps Serial1 and attaches the simulator behind it
+#if defined(USE_RN4020_SIMULATOR)
+#define RN4020_PORT     Rn4020Sim
+#else
+#define RN4020_PORT     Serial1
+#endif
+
+#endif //_RN4020SIMULATOR_H_
@@ -4,10 +4,14 @@
 #include "CommonTool.h"
 #include "debug.h"
 
-SerialController::SerialController(HardwareSerial& serial)
-: _serial(serial)
+/**
+ *  serial is begun by owner
+ */
+SerialController::SerialController(Stream& serial)
+: _serial(serial),
+_timeout(1000),
+_lineLen(0)
 {
-    _serial.begin(115200);
 }
 
 SerialController::~SerialController()
@@ -16,7 +20,7 @@ SerialController::~SerialController()
 
 void SerialController::SetTimeout(uint32_t ms)
 {
-    _serial.setTimeout(ms);
+    _timeout = ms;
 }
 
 void SerialController::PrintLn(const char* str)
@@ -24,30 +28,52 @@ void SerialController::PrintLn(const char* str)
     _serial.println(str);
 }
 
-void SerialController::ReadLine(char* buf, int buf_len)
+bool SerialController::ReadLine(StrView_t* line)
 {
-    memset(buf, 0, sizeof(buf));
-    String recv = _serial.readStringUntil('\n');
-   	LOG("received:");
-    LOG(recv);
-    recv.toCharArray(buf, buf_len);
+    uint32_t start = millis();
+    while(!PollLine(line)) {
+        if(_timeout < millis() - start) {
+            LOG("timeout");
+            return false;
+        }
+    }
+    return true;
 }
 
-const char* SerialController::WaitForOneOfWords(const char** words, int wordNum, int sleep, int retry)
+bool SerialController::PollLine(StrView_t* line)
 {
-    char buf[64] = {0};
+    while(_serial.available() > 0) {
+        char c = _serial.read();
+        if(c == '\r') {
+            continue;
+        }
+        if(c == '\n') {
+            line->str = _line;
+            line->len = _lineLen;
+            _lineLen = 0;
+            return true;
+        }
+        if(_lineLen < SERIAL_LINE_MAX) {
+            // too long line is truncated
+            _line[_lineLen++] = c;
+        }
+    }
+    return false;
+}
 
+const char* SerialController::WaitForOneOfWords(const char** words, int wordNum, int sleep, int retry)
+{
+    StrView_t line;
     for(int i = 0; i < retry; i++)
     {
-        ReadLine(buf, sizeof(buf));
-        
-        for(int j = 0; j < wordNum; j++) {
-            const char* word = words[j];
-        
-    		if (strncmp(word, buf, strlen(word)) == 0) {
-    	        LOG("word received");
-    	        return word;
-    		}
+        if(ReadLine(&line)) {
+            for(int j = 0; j < wordNum; j++) {
+                const char* word = words[j];
+                if(viewStartsWith(&line, word)) {
+                    LOG("word received");
+                    return word;
+                }
+            }
         }
 		LOG("waiting for a words");
 		delay(sleep);
@@ -58,9 +84,11 @@ const char* SerialController::WaitForOneOfWords(const char** words, int wordNum,
 
 void SerialController::Purge()
 {
+    _lineLen = 0;
     while(_serial.available() > 0) {
         char c = _serial.read();
         LOG(c);
+        (void)c;    // LOG is empty in release
         delay(10);
     }
 }
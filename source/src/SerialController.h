@@ -2,25 +2,44 @@
 #define _SERIALCONTROLLER_H_
 
 #include <inttypes.h>
+#include "StringUtility.h"
 
-class HardwareSerial;
+#define SERIAL_LINE_MAX     64
 
+class Stream;
+
+/**
+ *  lines are assembled in a fixed buffer and returned as views into it.
+ *  a view is valid until next PollLine() or ReadLine()
+ */
 class SerialController
 {
 public:
-    SerialController(HardwareSerial& serial);
+    SerialController(Stream& serial);
     ~SerialController();
     
     void SetTimeout(uint32_t ms);
     void PrintLn(const char* str);
-    void ReadLine(char* buf, int buf_len);
+    /**
+     *  waits a line for timeout set by SetTimeout()
+     *  @return false on timeout
+     */
+    bool ReadLine(StrView_t* line);
+    /**
+     *  never blocks. bytes received so far are kept until a line completes
+     *  @return false if no line is completed yet
+     */
+    bool PollLine(StrView_t* line);
     
     const char* WaitForOneOfWords(const char** words, int wordNum, int sleep, int retry);
     bool WaitForWord(const char* word, int sleep, int retry);
     void Purge();
     
 private:
-    HardwareSerial& _serial;
+    Stream& _serial;
+    uint32_t _timeout;
+    char _line[SERIAL_LINE_MAX];
+    uint8_t _lineLen;
 };
 
 #endif
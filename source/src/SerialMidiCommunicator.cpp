@@ -0,0 +1,150 @@
+#include "SerialMidiCommunicator.h"
+#include "Arduino.h"
+
+// general midi program for kInst*
+#define PROGRAM_HMK     52  // Choir Aahs
+#define PROGRAM_PNO     0   // Piano
+#define PROGRAM_TRP     56  // Trumpet
+#define PROGRAM_ORC     48  // String Ensemble
+
+SerialMidiCommunicator::SerialMidiCommunicator(HardwareSerial& serial, uint32_t baud)
+:
+_serial(serial),
+_baud(baud),
+_runningStatus(0),
+_lastSent(0),
+_bendMode(kBendOff),
+_bend(BEND_CENTER),
+_pressure(0),
+_bendSent(0)
+{
+    _gainVal = 1;
+}
+
+/**
+ *  never tested
+ */
+SerialMidiCommunicator::~SerialMidiCommunicator()
+{
+}
+
+uint32_t SerialMidiCommunicator::Initialize()
+{
+    _serial.begin(_baud);
+    sendMessage(0xC0 | SERIAL_MIDI_CH, PROGRAM_HMK, 0, 1);
+    sendMessage(0xE0 | SERIAL_MIDI_CH, BEND_CENTER & 0x7F, BEND_CENTER >> 7, 2);
+    return 0;
+}
+
+uint32_t SerialMidiCommunicator::Yield()
+{
+    DispatchEvents();
+    return 0;
+}
+
+/**
+ *  timestamp is not sent. bytes leave as soon as the tx ring lets them
+ */
+void SerialMidiCommunicator::UpdateFreq(uint16_t freq, uint16_t note, uint16_t volume, uint16_t timestamp)
+{
+    if(_pitchVal[1] == note) {
+        return;
+    }
+    if(_pitchVal[1] != 0) {
+        // note on with velocity 0 keeps running status of note on
+        sendMessage(0x90 | SERIAL_MIDI_CH, (uint8_t)_pitchVal[1], 0, 2);
+    }
+    if(note != 0) {
+        if(_bend != BEND_CENTER) {
+            // new note starts in tune
+            _bend = BEND_CENTER;
+            sendMessage(0xE0 | SERIAL_MIDI_CH, BEND_CENTER & 0x7F, BEND_CENTER >> 7, 2);
+        }
+        sendMessage(0x90 | SERIAL_MIDI_CH, (uint8_t)note, velocityOf(volume), 2);
+    }
+    _pitchVal[0] = freq;
+    _pitchVal[1] = note;
+}
+
+uint8_t SerialMidiCommunicator::GetGain()
+{
+    return _gainVal;
+}
+
+void SerialMidiCommunicator::ChangeInst(uint8_t inst)
+{
+    uint8_t program = PROGRAM_PNO;
+    switch(inst) {
+        case kInstHmk:
+            program = PROGRAM_HMK;
+            break;
+        case kInstTrp:
+            program = PROGRAM_TRP;
+            break;
+        case kInstOrc:
+            program = PROGRAM_ORC;
+            break;
+        case kInstPno:
+        default:
+            break;
+    }
+    if(_pitchVal[1] != 0) {
+        sendMessage(0x90 | SERIAL_MIDI_CH, (uint8_t)_pitchVal[1], 0, 2);
+        _pitchVal[1] = 0;
+    }
+    sendMessage(0xC0 | SERIAL_MIDI_CH, program, 0, 1);
+}
+
+void SerialMidiCommunicator::SetBendMode(uint8_t mode)
+{
+    _bendMode = mode;
+}
+
+/**
+ *  wire has room for every frame. only small changes are dropped.
+ *  pressure uses PRESSURE_MIN_DELTA shared with BLE-MIDI
+ */
+void SerialMidiCommunicator::UpdatePitch(const PitchSample_t* sample)
+{
+    if(_bendMode == kBendOff || _pitchVal[1] == 0) {
+        return;
+    }
+    uint32_t now = millis();
+    if((uint32_t)(now - _bendSent) < SERIAL_MIDI_BEND_INTERVAL) {
+        return;
+    }
+
+    uint16_t bend = bendOf(sample->cents);
+    if(SERIAL_MIDI_BEND_MIN_DELTA <= labs((int32_t)bend - _bend)) {
+        sendMessage(0xE0 | SERIAL_MIDI_CH, bend & 0x7F, (bend >> 7) & 0x7F, 2);
+        _bend = bend;
+        _bendSent = now;
+    }
+    uint8_t pressure = (uint8_t)(sample->volume >> 3);
+    if(_bendMode == kBendPitchPressure && PRESSURE_MIN_DELTA <= abs((int16_t)pressure - _pressure)) {
+        sendMessage(0xD0 | SERIAL_MIDI_CH, pressure, 0, 1);
+        _pressure = pressure;
+        _bendSent = now;
+    }
+}
+
+/**
+ *  status is omitted while it equals the previous one
+ */
+void SerialMidiCommunicator::sendMessage(uint8_t status, uint8_t data1, uint8_t data2, uint8_t dataLen)
+{
+    uint32_t now = millis();
+    if(SERIAL_MIDI_STATUS_REFRESH <= now - _lastSent) {
+        _runningStatus = 0;
+    }
+    _lastSent = now;
+
+    if(status != _runningStatus) {
+        _serial.write(status);
+        _runningStatus = status;
+    }
+    _serial.write(data1);
+    if(dataLen == 2) {
+        _serial.write(data2);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef _SERIALMIDICOMMUNICATOR_H_
+#define _SERIALMIDICOMMUNICATOR_H_
+
+#include "Communicator.h"
+
+class HardwareSerial;
+
+#define SERIAL_MIDI_PORT            Serial1
+#define SERIAL_MIDI_BAUD            31250   // din. usb-serial bridges take 115200 or more
+#define SERIAL_MIDI_CH              0
+#define SERIAL_MIDI_STATUS_REFRESH  1000    // ms. status is resent after idle for late plugged receivers
+#define SERIAL_MIDI_BEND_INTERVAL   10      // ms between pitch bends
+#define SERIAL_MIDI_BEND_MIN_DELTA  32      // about 0.8 cents
+
+/**
+ *  raw midi bytes on a uart for a wired path.
+ *  bytes go to the tx ring of HardwareSerial which is drained by its interrupt.
+ *  running status is used for consecutive messages of the same status.
+ *  response melodies are not played. instruments change at once.
+ */
+class SerialMidiCommunicator : public Communicator
+{
+public:
+    SerialMidiCommunicator(HardwareSerial& serial, uint32_t baud = SERIAL_MIDI_BAUD);
+    ~SerialMidiCommunicator();
+
+    virtual uint32_t Initialize();
+    virtual uint32_t Yield();
+    virtual void UpdateFreq(uint16_t freq, uint16_t note, uint16_t volume, uint16_t timestamp);
+    virtual uint8_t GetGain();
+    virtual void ChangeInst(uint8_t inst);
+    virtual void SetBendMode(uint8_t mode);
+    virtual void UpdatePitch(const PitchSample_t* sample);
+
+private:
+    HardwareSerial& _serial;
+    uint32_t _baud;
+    uint8_t _runningStatus;     // 0 if next message must send its status
+    uint32_t _lastSent;         // millis of last message
+    uint8_t _bendMode;
+    uint16_t _bend;
+    uint8_t _pressure;
+    uint32_t _bendSent;
+
+    void sendMessage(uint8_t status, uint8_t data1, uint8_t data2, uint8_t dataLen);
+};
+
+#endif //_SERIALMIDICOMMUNICATOR_H_
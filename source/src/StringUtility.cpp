@@ -4,61 +4,60 @@
 
 using namespace std;
 
-const char* getCommaSeparatedWord(const char* str, int *wordLen)
+/**
+ *  one pass over str. words share the memory of str
+ *  @return number of words. words after wordMax are not stored
+ */
+uint8_t splitCommaSeparated(const char* str, uint8_t len, StrView_t* words, uint8_t wordMax)
 {
 	assert(str != NULL);
 
-	int len = strlen(str);
-	assert(1 <= len);
-
-	*wordLen = 0;
-	int idx_first = 0;
-	int idx_last = len - 1;
-	for (int i = 1; i < len; i++) {
-		if (str[i] == ',') {
-			idx_last = i-1;
-			break;
+	uint8_t num = 0;
+	uint16_t first = 0;
+	// i reaches len to close the last word. uint8_t would wrap at len 255
+	for (uint16_t i = 0; i <= len; i++) {
+		if (i != len && str[i] != ',') {
+			continue;
+		}
+		if (num < wordMax) {
+			words[num].str = &str[first];
+			words[num].len = i - first;
 		}
+		num++;
+		first = i + 1;
 	}
-	*wordLen = idx_last - idx_first + 1;
-	return &(str[idx_first]);
+	return num;
 }
 
-char* copyCommaSeparatedWord(const char* str, char* buf, int buf_len)
+bool viewEquals(const StrView_t* view, const char* str)
 {
-	assert(str != NULL);
-	assert(buf != NULL);
-
-	int len = 0;
-	const char* ptr = getCommaSeparatedWord(str, &len);
+	return strncmp(view->str, str, view->len) == 0 && str[view->len] == '\0';
+}
 
-	strncpy(buf, ptr, min(buf_len,len));
-	if (len >= buf_len) {
-		buf[buf_len - 1] = '\0';
-	}
-	else {
-		buf[len] = '\0';
-	}
-	return buf;
+bool viewStartsWith(const StrView_t* view, const char* prefix)
+{
+	uint8_t len = strlen(prefix);
+	return len <= view->len && strncmp(view->str, prefix, len) == 0;
 }
 
-void itoaUi16(uint16_t val, char* output)
+void copyView(const StrView_t* view, char* buf, int buf_len)
 {
-    char buf[16] = {0};
-    itoa((int)val, buf, 16);
+	assert(buf != NULL);
 
-    if(strlen(buf) == 1) {
-        output[0] = '0';
-        output[1] = buf[0];
-    } else {
-        output[0] = buf[0];
-        output[1] = buf[1];
-    }
+	int len = min(buf_len - 1, (int)view->len);
+	memcpy(buf, view->str, len);
+	buf[len] = '\0';
 }
 
-void itoaUi8(uint8_t val, char* output)
+static const char kHexDigits[16] = {
+	'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
+};
+
+/**
+ *  two hex digits of val. output is not null terminated
+ */
+void hexUi8(uint8_t val, char* output)
 {
-    char buf[16] = {0};
-    itoa((int)val, buf, 16);
-    output[0] = buf[0];
+	output[0] = kHexDigits[val >> 4];
+	output[1] = kHexDigits[val & 0x0F];
 }
@@ -2,15 +2,25 @@
 #define _STRINGUTILITY_H_
 
 #include <inttypes.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
-const char* getCommaSeparatedWord(const char* str, int *wordLen);
-char* copyCommaSeparatedWord(const char* str, char* buf, int buf_len);
-void itoaUi16(uint16_t val, char* output);
-void itoaUi8(uint8_t val, char* output);
+/**
+ *  part of a string. not null terminated
+ */
+typedef struct StrView_tag {
+    const char* str;
+    uint8_t len;
+} StrView_t;
+
+uint8_t splitCommaSeparated(const char* str, uint8_t len, StrView_t* words, uint8_t wordMax);
+bool viewEquals(const StrView_t* view, const char* str);
+bool viewStartsWith(const StrView_t* view, const char* prefix);
+void copyView(const StrView_t* view, char* buf, int buf_len);
+void hexUi8(uint8_t val, char* output);
 
 #ifdef __cplusplus
 }